@@ -0,0 +1,85 @@
+/* aiocat.c
+
+   Prints the contents of a file like cat, but reads it through an
+   aio_ring with DEPTH reads in flight at a time, e.g.
+     pintos -- -q run 'aiocat file 8' */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define CHUNK 4096
+#define MAX_DEPTH 8
+
+static struct aio_ring ring __attribute__ ((aligned (4096)));
+static char buffers[MAX_DEPTH][CHUNK] __attribute__ ((aligned (4096)));
+static int lengths[MAX_DEPTH];
+
+int
+main (int argc, char *argv[]) 
+{
+  int depth = argc > 2 ? atoi (argv[2]) : 4;
+  unsigned offset = 0;
+  bool eof = false;
+  int fd, i;
+
+  if (argc < 2 || argc > 3 || depth <= 0 || depth > MAX_DEPTH)
+    {
+      printf ("usage: %s FILE [DEPTH]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  fd = open (argv[1]);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  if (!aio_setup (&ring))
+    {
+      printf ("aio_setup failed\n");
+      return EXIT_FAILURE;
+    }
+
+  while (!eof)
+    {
+      /* Queue a read of the next DEPTH chunks and wait for all of
+         them, in whatever order they finish. */
+      for (i = 0; i < depth; i++)
+        {
+          struct aio_sqe *sqe = &ring.sq[ring.sq_tail % AIO_RING_ENTRIES];
+          sqe->opcode = AIO_READ;
+          sqe->fd = fd;
+          sqe->buf = buffers[i];
+          sqe->size = CHUNK;
+          sqe->offset = offset + i * CHUNK;
+          sqe->user_data = i;
+          ring.sq_tail++;
+        }
+      if (aio_submit (depth, depth) != depth)
+        {
+          printf ("aio_submit failed\n");
+          return EXIT_FAILURE;
+        }
+      while (ring.cq_head != ring.cq_tail)
+        {
+          struct aio_cqe *cqe = &ring.cq[ring.cq_head % AIO_RING_ENTRIES];
+          lengths[cqe->user_data] = cqe->result;
+          ring.cq_head++;
+        }
+
+      /* Print them in file order. */
+      for (i = 0; i < depth && !eof; i++)
+        {
+          if (lengths[i] < 0)
+            {
+              printf ("%s: read failed\n", argv[1]);
+              return EXIT_FAILURE;
+            }
+          write (STDOUT_FILENO, buffers[i], lengths[i]);
+          eof = lengths[i] < CHUNK;
+        }
+      offset += depth * CHUNK;
+    }
+
+  return EXIT_SUCCESS;
+}
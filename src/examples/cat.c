@@ -20,6 +20,7 @@ main (int argc, char *argv[])
           success = false;
           continue;
         }
+      fadvise (fd, 0, 0, ADV_SEQUENTIAL);
       for (;;) 
         {
           char buffer[1024];
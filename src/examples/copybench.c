@@ -0,0 +1,101 @@
+/* copybench.c
+
+   Writes a file of KB kilobytes, then copies it COUNT times either
+   inside the kernel with copy_file_range() ("kernel") or through a
+   user buffer with read() and write() ("user").  Run each mode on a
+   fresh file system, e.g.
+     pintos --filesys-size=8 -- -q -f run 'copybench 1024 4 kernel'
+   and compare the timer ticks and file system reads and writes
+   printed at power off. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+static char buffer[4096];
+
+/* Copies all of IN_FD to OUT_FD through buffer.  Returns false on a
+   short write. */
+static bool
+copy_user (int in_fd, int out_fd)
+{
+  for (;;) 
+    {
+      int bytes_read = read (in_fd, buffer, sizeof buffer);
+      if (bytes_read == 0)
+        return true;
+      if (write (out_fd, buffer, bytes_read) != bytes_read)
+        return false;
+    }
+}
+
+/* Copies all of IN_FD to OUT_FD with copy_file_range().  Returns
+   false on error. */
+static bool
+copy_kernel (int in_fd, int out_fd)
+{
+  for (;;) 
+    {
+      int bytes_copied = copy_file_range (in_fd, out_fd, 65536);
+      if (bytes_copied == 0)
+        return true;
+      if (bytes_copied < 0)
+        return false;
+    }
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  int kb = argc > 1 ? atoi (argv[1]) : 1024;
+  int count = argc > 2 ? atoi (argv[2]) : 4;
+  bool kernel = argc <= 3 || !strcmp (argv[3], "kernel");
+  char name[16];
+  int in_fd, i;
+
+  if (argc > 4 || kb <= 0 || count <= 0
+      || (argc > 3 && !kernel && strcmp (argv[3], "user")))
+    {
+      printf ("usage: %s [KB [COUNT [kernel|user]]]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* Write the source file. */
+  memset (buffer, 'x', sizeof buffer);
+  if (!create ("source", 0) || (in_fd = open ("source")) < 0) 
+    {
+      printf ("source: create failed\n");
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < kb / 4; i++)
+    if (write (in_fd, buffer, sizeof buffer) != sizeof buffer) 
+      {
+        printf ("source: write failed\n");
+        return EXIT_FAILURE;
+      }
+
+  /* Copy it. */
+  for (i = 0; i < count; i++) 
+    {
+      int out_fd;
+
+      snprintf (name, sizeof name, "copy%d", i);
+      if (!create (name, 0) || (out_fd = open (name)) < 0) 
+        {
+          printf ("%s: create failed\n", name);
+          return EXIT_FAILURE;
+        }
+      seek (in_fd, 0);
+      if (!(kernel ? copy_kernel : copy_user) (in_fd, out_fd)) 
+        {
+          printf ("%s: copy failed\n", name);
+          return EXIT_FAILURE;
+        }
+      close (out_fd);
+    }
+  printf ("copied %d KB %d times with %s\n", kb / 4 * 4, count,
+          kernel ? "copy_file_range" : "read and write");
+
+  return EXIT_SUCCESS;
+}
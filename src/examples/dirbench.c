@@ -0,0 +1,61 @@
+/* dirbench.c
+
+   Creates COUNT empty files in a new directory DIR, then opens
+   each of them again by name.  Run it with a file system large
+   enough for COUNT inodes, e.g.
+     pintos --filesys-size=16 -- -q -f run 'dirbench 10000'
+   and compare the timer ticks and file system reads and writes
+   printed at power off. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+int
+main (int argc, char *argv[]) 
+{
+  const char *dir = argc > 2 ? argv[2] : "bench";
+  int count = argc > 1 ? atoi (argv[1]) : 10000;
+  char name[64];
+  int i;
+
+  if (argc > 3 || count <= 0)
+    {
+      printf ("usage: %s [COUNT [DIR]]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (!mkdir (dir)) 
+    {
+      printf ("%s: mkdir failed\n", dir);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < count; i++) 
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      if (!create (name, 0)) 
+        {
+          printf ("%s: create failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+  printf ("created %d files in %s\n", count, dir);
+
+  for (i = 0; i < count; i++) 
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      fd = open (name);
+      if (fd < 0) 
+        {
+          printf ("%s: open failed\n", name);
+          return EXIT_FAILURE;
+        }
+      close (fd);
+    }
+  printf ("looked up %d files in %s\n", count, dir);
+
+  return EXIT_SUCCESS;
+}
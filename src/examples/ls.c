@@ -15,48 +15,53 @@
 static bool
 list_dir (const char *dir, bool verbose) 
 {
+  struct stat st;
   int dir_fd = open (dir);
-  if (dir_fd == -1) 
+  if (dir_fd == -1 || !fstat (dir_fd, &st)) 
     {
       printf ("%s: not found\n", dir);
+      close (dir_fd);
       return false;
     }
 
-  if (isdir (dir_fd))
+  if (st.is_dir)
     {
-      char name[READDIR_MAX_LEN];
+      struct dirent entries[16];
+      int cnt, i;
 
       printf ("%s", dir);
       if (verbose)
-        printf (" (inumber %d)", inumber (dir_fd));
+        printf (" (inumber %d)", st.inumber);
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
-        {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+      /* Read the directory a batch of entries at a time */
+      while ((cnt = getdents (dir_fd, entries,
+                              sizeof entries / sizeof *entries)) > 0)
+        for (i = 0; i < cnt; i++)
+          {
+            struct dirent *e = &entries[i];
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+            printf ("%s", e->name); 
+            if (verbose) 
+              {
+                printf (": ");
+                if (e->is_dir)
+                  printf ("directory");
+                else
+                  {
+                    char full_name[128];
 
-              printf (": ");
-              if (entry_fd != -1)
-                {
-                  if (isdir (entry_fd))
-                    printf ("directory");
-                  else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
-                }
-              else
-                printf ("open failed");
-              close (entry_fd);
-            }
-          printf ("\n");
-        }
+                    snprintf (full_name, sizeof full_name, "%s/%s",
+                              dir, e->name);
+                    if (stat (full_name, &st))
+                      printf ("%d-byte file", st.size);
+                    else
+                      printf ("stat failed");
+                  }
+                printf (", inumber %d", e->inumber);
+              }
+            printf ("\n");
+          }
     }
   else 
     printf ("%s: not a directory\n", dir);
@@ -34,6 +34,7 @@ main (int argc, char *argv[])
           printf ("%s: mmap failed\n", argv[i]);
           return EXIT_FAILURE;
         }
+      madvise (data, size, ADV_SEQUENTIAL);
 
       /* Write file to console. */
       write (STDOUT_FILENO, data, size);
@@ -0,0 +1,63 @@
+/* nullcall.c
+
+   Measures the cost of entering and leaving the kernel by timing
+   COUNT calls of tell() on a file descriptor that is not open, which
+   does no more than look the descriptor up.  The calls are made
+   through `int $0x30' and, if the CPU supports it, through sysenter,
+   and the average number of cycles per call is printed for each,
+   e.g.
+     pintos -- -q run 'nullcall 100000' */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <sysenter.h>
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Prints the cycles per call of COUNT null system calls made with
+   sysenter if SYSENTER is true, otherwise with `int $0x30'. */
+static void
+measure (int count, bool sysenter)
+{
+  uint64_t start, cycles;
+  int i;
+
+  syscall_sysenter = sysenter;
+  start = rdtsc ();
+  for (i = 0; i < count; i++)
+    tell (-1);
+  cycles = rdtsc () - start;
+  printf ("%-10s %llu cycles per call\n", sysenter ? "sysenter" : "int $0x30",
+          cycles / count);
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  int count = argc > 1 ? atoi (argv[1]) : 100000;
+  bool sysenter = syscall_sysenter;
+
+  if (argc > 2 || count <= 0)
+    {
+      printf ("usage: %s [COUNT]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  measure (count, false);
+  if (sysenter_supported ())
+    measure (count, true);
+  else
+    printf ("sysenter not supported\n");
+  syscall_sysenter = sysenter;
+
+  return EXIT_SUCCESS;
+}
@@ -26,16 +26,15 @@ main (void)
 }
 
 /* Stores the inode number for FILE_NAME in *INUM.
-   Returns true if successful, false if the file could not be
-   opened. */
+   Returns true if successful, false if the file does not
+   exist. */
 static bool
 get_inumber (const char *file_name, int *inum) 
 {
-  int fd = open (file_name);
-  if (fd >= 0) 
+  struct stat st;
+  if (stat (file_name, &st)) 
     {
-      *inum = inumber (fd);
-      close (fd);
+      *inum = st.inumber;
       return true;
     }
   else
@@ -115,14 +114,17 @@ getcwd (char *cwd, size_t cwd_size)
          inumber. */
       for (;;)
         {
-          int test_inum;
-          if (!readdir (parent_fd, namep) || !get_inumber (name, &test_inum)) 
+          struct dirent e;
+          if (getdents (parent_fd, &e, 1) != 1) 
             {
               close (parent_fd);
               return false; 
             }
-          if (test_inum == child_inum)
-            break;
+          if (e.inumber == child_inum)
+            {
+              strlcpy (namep, e.name, READDIR_MAX_LEN + 1);
+              break;
+            }
         }
       close (parent_fd);
 
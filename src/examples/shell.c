@@ -3,8 +3,12 @@
 #include <string.h>
 #include <syscall.h>
 
+/* Maximum number of commands in a pipeline. */
+#define MAX_STAGES 8
+
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +34,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +50,82 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Runs COMMAND, a list of commands separated by "|", with each
+   command's output connected to the next one's input by a pipe.
+   Each child inherits the pipe ends that the shell dups onto its
+   stdin and stdout; closing them afterward gives the shell back the
+   console. */
+static void
+run_pipeline (char *command)
+{
+  char *stages[MAX_STAGES];
+  pid_t pids[MAX_STAGES];
+  char *stage, *save_ptr;
+  int stage_cnt = 0;
+  int read_fd = -1;
+  int i;
+
+  /* Split the pipeline, trimming spaces around each command. */
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      char *end;
+
+      while (*stage == ' ')
+        stage++;
+      for (end = stage + strlen (stage); end > stage && end[-1] == ' '; )
+        *--end = '\0';
+      if (*stage == '\0' || stage_cnt >= MAX_STAGES)
+        {
+          printf ("bad pipeline\n");
+          return;
+        }
+      stages[stage_cnt++] = stage;
+    }
+
+  /* Start the commands from left to right. */
+  for (i = 0; i < stage_cnt; i++)
+    {
+      if (read_fd != -1)
+        {
+          dup2 (read_fd, STDIN_FILENO);
+          close (read_fd);
+          read_fd = -1;
+        }
+      if (i < stage_cnt - 1)
+        {
+          int fds[2];
+          if (!pipe (fds))
+            {
+              printf ("pipe failed\n");
+              if (i > 0)
+                close (STDIN_FILENO);
+              stage_cnt = i;
+              break;
+            }
+          dup2 (fds[1], STDOUT_FILENO);
+          close (fds[1]);
+          read_fd = fds[0];
+        }
+
+      pids[i] = exec (stages[i]);
+
+      if (i > 0)
+        close (STDIN_FILENO);
+      if (i < stage_cnt - 1)
+        close (STDOUT_FILENO);
+      if (pids[i] == PID_ERROR)
+        printf ("\"%s\": exec failed\n", stages[i]);
+    }
+  if (read_fd != -1)
+    close (read_fd);
+
+  /* Wait for all of them. */
+  for (i = 0; i < stage_cnt; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
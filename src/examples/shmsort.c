@@ -0,0 +1,144 @@
+/* shmsort.c
+
+   Sorts 1 MB of random bytes like the page-merge-par test, but passes
+   the data through a shared memory segment instead of files.  The
+   parent fills the segment and runs CHUNK_CNT copies of
+   "shmsort CHUNK".  Each child maps the same segment and sorts its own
+   chunk in place.  Then the parent merges the chunks and checks the
+   result.  Compare the file system reads and writes printed at power
+   off with those of page-merge-par, e.g.
+     pintos -p ../examples/shmsort -a shmsort -- -q -f run shmsort */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define CHUNK_SIZE (128 * 1024)
+#define CHUNK_CNT 8                             /* Number of chunks. */
+#define DATA_SIZE (CHUNK_CNT * CHUNK_SIZE)      /* Segment size. */
+
+/* Every process maps the segment here. */
+static unsigned char *const data = (unsigned char *) 0x10000000;
+
+static unsigned char merged[DATA_SIZE];
+static size_t histogram[256];
+
+/* Opens the segment, creating it with SIZE bytes if needed, and maps
+   it at DATA.  Returns false on failure. */
+static bool
+map_data (unsigned size) 
+{
+  int fd = shm_open ("shmsort", size);
+  bool success;
+
+  if (fd < 0)
+    return false;
+  success = shm_map (fd, data) != MAP_FAILED;
+  close (fd);
+  return success;
+}
+
+/* Sorts chunk CHUNK of the segment in place with a counting sort. */
+static void
+sort_chunk (int chunk) 
+{
+  unsigned char *buf = data + CHUNK_SIZE * chunk;
+  size_t counts[256] = {0};
+  size_t i, value;
+
+  for (i = 0; i < CHUNK_SIZE; i++)
+    counts[buf[i]]++;
+  for (value = 0; value < 256; value++)
+    for (i = 0; i < counts[value]; i++)
+      *buf++ = value;
+}
+
+/* Merges the sorted chunks of the segment into MERGED. */
+static void
+merge (void) 
+{
+  unsigned char *mp[CHUNK_CNT];
+  size_t mp_left = CHUNK_CNT;
+  unsigned char *op = merged;
+  size_t i;
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    mp[i] = data + CHUNK_SIZE * i;
+
+  while (mp_left > 0) 
+    {
+      size_t min = 0;
+      for (i = 1; i < mp_left; i++)
+        if (*mp[i] < *mp[min])
+          min = i;
+
+      *op++ = *mp[min];
+      if ((++mp[min] - data) % CHUNK_SIZE == 0) 
+        mp[min] = mp[--mp_left];
+    }
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  pid_t children[CHUNK_CNT];
+  size_t i, value, idx;
+
+  /* Child: sort one chunk. */
+  if (argc == 2)
+    {
+      if (!map_data (0))
+        return EXIT_FAILURE;
+      sort_chunk (atoi (argv[1]));
+      return EXIT_SUCCESS;
+    }
+
+  if (!map_data (DATA_SIZE))
+    {
+      printf ("%s: cannot map shared memory\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* Fill the segment. */
+  random_init (0);
+  random_bytes (data, DATA_SIZE);
+  for (i = 0; i < DATA_SIZE; i++)
+    histogram[data[i]]++;
+
+  /* Sort the chunks in parallel. */
+  for (i = 0; i < CHUNK_CNT; i++) 
+    {
+      char cmd[32];
+
+      snprintf (cmd, sizeof cmd, "%s %zu", argv[0], i);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("%s: exec failed\n", cmd);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < CHUNK_CNT; i++)
+    if (wait (children[i]) != EXIT_SUCCESS)
+      {
+        printf ("%s: chunk %zu failed\n", argv[0], i);
+        return EXIT_FAILURE;
+      }
+
+  /* Merge and check. */
+  merge ();
+  idx = 0;
+  for (value = 0; value < 256; value++)
+    for (i = 0; i < histogram[value]; i++, idx++)
+      if (merged[idx] != value)
+        {
+          printf ("%s: bad value %d in byte %zu\n",
+                  argv[0], merged[idx], idx);
+          return EXIT_FAILURE;
+        }
+
+  printf ("sorted %d bytes in %d chunks through shared memory\n",
+          DATA_SIZE, CHUNK_CNT);
+  return EXIT_SUCCESS;
+}
@@ -38,6 +38,8 @@ static void buffercache_flush_thread (void *aux);
 static void buffercache_readahead_thread (void *aux);
 static void buffercache_allocate_block (struct cache_entry *entry, void *kaddr);
 static struct cache_entry *buffercache_find_entry (const block_sector_t sector);
+static struct cache_entry *buffercache_find_ready (const block_sector_t sector);
+static bool buffercache_is_cached (const block_sector_t sector);
 static struct cache_entry *buffercache_replace (const block_sector_t
                                                 sector, enum sector_type type);
 static int buffercache_read_direct (const block_sector_t sector,
@@ -211,6 +213,66 @@ buffercache_write (const block_sector_t sector, enum sector_type type,
   }
 }
 
+/**
+ * Copies size bytes at src_ofs in sector src into dst at dst_ofs. When
+ * dst is already cached and idle the data moves straight from one cache
+ * block to the other. Otherwise it is staged on the stack, since waiting
+ * for dst while src is held could wait on src itself being evicted. Does not do
+ * bounds checking on the offsets and size.
+ *
+ * Returns the number of bytes copied.
+ */
+int
+buffercache_copy (const block_sector_t dst, const int dst_ofs,
+                  const block_sector_t src, const int src_ofs,
+                  const off_t size, const block_sector_t next_sector)
+{
+  struct cache_entry *src_entry, *dst_entry;
+
+  ASSERT (src_ofs + size <= BLOCK_SECTOR_SIZE);
+  ASSERT (dst_ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* Finds src and returns it with accessors incremented */
+  lock_acquire (&cache_lock);
+  src_entry = buffercache_find_entry (src);
+  if (src_entry == NULL)
+    src_entry = buffercache_replace (src, REGULAR);
+  ASSERT (src_entry->state == READY && src_entry->sector == src);
+  src_entry->accessed |= ACCESSED;
+
+  dst_entry = buffercache_find_ready (dst);
+  if (dst_entry != NULL)
+    dst_entry->accessed |= ACCESSED | DIRTY;
+  lock_release (&cache_lock);
+
+  if (dst_entry != NULL)
+  {
+    memmove (dst_entry->kaddr + dst_ofs, src_entry->kaddr + src_ofs, size);
+
+    lock_acquire (&cache_lock);
+    if (--src_entry->accessors == 0)
+      cond_broadcast (&src_entry->c, &cache_lock);
+    if (--dst_entry->accessors == 0)
+      cond_broadcast (&dst_entry->c, &cache_lock);
+    lock_release (&cache_lock);
+  } else {
+    uint8_t bounce[BLOCK_SECTOR_SIZE];
+    memcpy (bounce, src_entry->kaddr + src_ofs, size);
+
+    lock_acquire (&cache_lock);
+    if (--src_entry->accessors == 0)
+      cond_broadcast (&src_entry->c, &cache_lock);
+    lock_release (&cache_lock);
+
+    buffercache_write (dst, REGULAR, dst_ofs, size, bounce,
+                       INODE_INVALID_BLOCK_SECTOR);
+  }
+
+  /* Trigger read-ahead and return */
+  buffercache_readahead_if_necessary (next_sector);
+  return size;
+}
+
 /**
  * Flushes all dirty buffers in the cache to disk.
  */
@@ -227,6 +289,41 @@ buffercache_flush (const bool await)
   }
 }
 
+/**
+ * Queues an asynchronous read of sector into the cache, unless it is
+ * already cached or on its way in.
+ */
+void
+buffercache_readahead (const block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  bool cached = buffercache_is_cached (sector);
+  lock_release (&cache_lock);
+
+  if (!cached)
+    buffercache_readahead_if_necessary (sector);
+}
+
+/**
+ * Makes the cached block for sector, if any, the clock algorithm's
+ * first choice for replacement. A dirty block is still written back
+ * before it is reused.
+ */
+void
+buffercache_release (const block_sector_t sector)
+{
+  int i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cache_size; i++)
+    if (cache[i].sector == sector && cache[i].state == READY)
+    {
+      cache[i].accessed &= ~(ACCESSED | META);
+      break;
+    }
+  lock_release (&cache_lock);
+}
+
 /**
  * Daemon thread that flushes all buffers to disk every 30 seconds.
  */
@@ -444,6 +541,45 @@ buffercache_find_entry (const block_sector_t sector)
   return NULL;
 }
 
+/**
+ * Like buffercache_find_entry, but returns NULL rather than waiting if
+ * sector is not in a READY entry.
+ */
+static struct cache_entry *
+buffercache_find_ready (const block_sector_t sector)
+{
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < cache_size; i++)
+    if (cache[i].sector == sector && cache[i].state == READY)
+    {
+      cache[i].accessors++;     /* Prevent replacement */
+      return &cache[i];
+    }
+
+  return NULL;
+}
+
+/**
+ * Returns true if sector is cached or being read into the cache. Never
+ * waits.
+ */
+static bool
+buffercache_is_cached (const block_sector_t sector)
+{
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < cache_size; i++)
+    if (cache[i].sector == sector || cache[i].next_sector == sector)
+      return true;
+
+  return false;
+}
+
 /**
  * Use the clock algorithm to find an entry to replace (if necessary) and
  * flush it to disk (also if necessary) and load in a new sector.
@@ -63,6 +63,11 @@ int buffercache_read (const block_sector_t sector, enum sector_type type,
 int buffercache_write (const block_sector_t sector, enum sector_type type,
                        const int sector_ofs, const off_t size, const void *buf,
                        const block_sector_t next_sector);
+int buffercache_copy (const block_sector_t dst, const int dst_ofs,
+                      const block_sector_t src, const int src_ofs,
+                      const off_t size, const block_sector_t next_sector);
 void buffercache_flush (const bool await);
+void buffercache_readahead (const block_sector_t sector);
+void buffercache_release (const block_sector_t sector);
 
 #endif
@@ -1,7 +1,10 @@
  #include "filesys/directory.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/buffercache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
@@ -14,7 +17,7 @@ struct dir
 {
   struct inode *inode;   /* Backing store. */
   off_t pos;             /* Current position. */
-  struct lock l;		 /* Directory lock */
+  struct lock l;		 /* Protects pos */
 };
 
 /* A single directory entry. */
@@ -25,9 +28,250 @@ struct dir_entry
   bool in_use;                        /* In use or free? */
 };
 
+/* Directories start out as a flat array of dir_entry records.
+   Once one grows past DIR_LINEAR_SECTORS sectors it is rebuilt as
+   a hashed index in the style of ext3's htree: block 0 becomes a
+   dx_root that keeps "." and ".." where a linear directory has them
+   and maps ranges of name hashes to leaf blocks, optionally through
+   one level of dx_node blocks. A lookup then reads at most three
+   blocks no matter how large the directory is. */
+#define DIR_LINEAR_SECTORS 2
+
+#define DX_ROOT_MAGIC 0x44585254        /* "DXRT" */
+#define DX_NODE_MAGIC 0x44584e44        /* "DXND" */
+#define DX_LEAF_MAGIC 0x44584c46        /* "DXLF" */
+
+#define DX_ROOT_ENTRIES 57
+#define DX_NODE_ENTRIES 63
+#define DX_LEAF_ENTRIES 25
+
+/* Entries a leaf gets when a linear directory is converted, leaving
+   room to grow before it has to be split */
+#define DX_LEAF_FILL 16
+
+/* Index entry pointing at the block that holds every name whose
+   hash is at least HASH but less than the next entry's HASH. The
+   first entry of each index block has HASH 0. */
+struct dx_entry
+{
+  uint32_t hash;
+  uint32_t block;               /* Block index within the directory */
+};
+
+/* Block 0 of a hashed directory */
+struct dx_root
+{
+  struct dir_entry dot;         /* "." */
+  struct dir_entry dotdot;      /* ".." */
+  uint32_t magic;               /* DX_ROOT_MAGIC, where a linear
+                                   directory has a third entry */
+  uint8_t levels;               /* 0 if ENTRIES point at leaves,
+                                   1 if at dx_nodes */
+  uint8_t unused;
+  uint16_t count;               /* Entries in use */
+  uint32_t blocks;              /* Blocks in use, including this one */
+  struct dx_entry entries[DX_ROOT_ENTRIES];
+};
+
+/* Interior index block */
+struct dx_node
+{
+  uint32_t magic;               /* DX_NODE_MAGIC */
+  uint16_t count;               /* Entries in use */
+  uint16_t unused;
+  struct dx_entry entries[DX_NODE_ENTRIES];
+};
+
+/* Block of directory entries. Free slots have IN_USE false, as in a
+   linear directory. */
+struct dx_leaf
+{
+  uint32_t magic;               /* DX_LEAF_MAGIC */
+  uint32_t unused[2];
+  struct dir_entry entries[DX_LEAF_ENTRIES];
+};
+
+/* Path from the root of a hashed directory down to a leaf */
+struct dx_frame
+{
+  struct dx_root root;
+  struct dx_node node;          /* Only if ROOT.levels is 1 */
+  struct dx_entry *root_at;     /* Entry followed in ROOT */
+  struct dx_entry *node_at;     /* Entry followed in NODE */
+  uint32_t node_block;          /* Block holding NODE */
+  uint32_t leaf_block;          /* Leaf the path ends in */
+};
+
+/* Cached result of looking up NAME in the directory whose inode is
+   in sector PARENT. Names known not to exist have SECTOR set to
+   INODE_INVALID_BLOCK_SECTOR. */
+struct dentry
+{
+  struct hash_elem elem;        /* Element in dcache */
+  struct list_elem lru_elem;    /* Element in dcache_lru */
+  block_sector_t parent;        /* Directory searched */
+  block_sector_t sector;        /* Inode found, if any */
+  char name[NAME_MAX + 1];      /* Name searched for */
+};
+
+/* Maximum number of dentries kept */
+#define DCACHE_SIZE 256
+
+/* Dentry cache, so that resolving a path walks memory instead of
+   the directories' blocks */
+static struct hash dcache;
+static struct list dcache_lru;  /* Least recently used first */
+static size_t dcache_cnt;
+static unsigned dcache_gen;     /* Bumped whenever a directory changes */
+static struct lock dcache_lock; /* Protects the variables above */
+
 static bool lookup (const struct dir *dir, const char *name,
                     struct dir_entry *ep, off_t *ofsp);
 static size_t dir_size (struct dir *dir);
+static bool dir_next (struct inode *inode, off_t *pos,
+                      struct dir_entry *ep);
+
+/* Hashes a dentry by its directory and name */
+static unsigned
+dentry_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct dentry *d = hash_entry (e, struct dentry, elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_hash_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                       void *aux UNUSED)
+{
+  struct dentry *lhs = hash_entry (a, struct dentry, elem);
+  struct dentry *rhs = hash_entry (b, struct dentry, elem);
+  if (lhs->parent != rhs->parent)
+    return lhs->parent < rhs->parent;
+  return strcmp (lhs->name, rhs->name) < 0;
+}
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  hash_init (&dcache, dentry_hash_func, dentry_hash_less_func, NULL);
+  list_init (&dcache_lru);
+  dcache_cnt = 0;
+  dcache_gen = 0;
+  lock_init (&dcache_lock);
+}
+
+/* Drops dentry D from the cache. dcache_lock must be held. */
+static void
+dcache_drop (struct dentry *d)
+{
+  hash_delete (&dcache, &d->elem);
+  list_remove (&d->lru_elem);
+  dcache_cnt--;
+  free (d);
+}
+
+/* Looks NAME up in the directory at sector PARENT in the dentry
+   cache. On a hit stores the sector it resolves to in *SECTOR and
+   returns true. On a miss stores the cache generation in *GEN, to
+   be passed to dcache_insert() with the result read from disk. */
+static bool
+dcache_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sector, unsigned *gen)
+{
+  struct dentry key;
+  struct hash_elem *e = NULL;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+
+  lock_acquire (&dcache_lock);
+  e = hash_find (&dcache, &key.elem);
+  if (e != NULL)
+  {
+    struct dentry *d = hash_entry (e, struct dentry, elem);
+    list_remove (&d->lru_elem);
+    list_push_back (&dcache_lru, &d->lru_elem);
+    *sector = d->sector;
+  }
+  else
+    *gen = dcache_gen;
+  lock_release (&dcache_lock);
+  return e != NULL;
+}
+
+/* Caches that NAME in directory PARENT resolves to SECTOR, unless
+   a directory has changed since generation GEN or PARENT has been
+   removed, either of which could make the result stale. */
+static void
+dcache_insert (struct inode *parent, const char *name,
+               block_sector_t sector, unsigned gen)
+{
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  struct dentry *d = NULL;
+  if (gen == dcache_gen && !inode_is_removed (parent))
+    d = malloc (sizeof *d);
+  if (d != NULL)
+  {
+    d->parent = inode_get_inumber (parent);
+    d->sector = sector;
+    strlcpy (d->name, name, sizeof d->name);
+    if (hash_insert (&dcache, &d->elem) == NULL)
+    {
+      list_push_back (&dcache_lru, &d->lru_elem);
+      dcache_cnt++;
+      while (dcache_cnt > DCACHE_SIZE)
+        dcache_drop (list_entry (list_front (&dcache_lru), struct dentry,
+                                 lru_elem));
+    }
+    else
+      free (d);
+  }
+  lock_release (&dcache_lock);
+}
+
+/* Forgets what NAME in directory PARENT resolves to. Must be called
+   after the directory itself has been changed. */
+static void
+dcache_invalidate (block_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  e = hash_find (&dcache, &key.elem);
+  if (e != NULL)
+    dcache_drop (hash_entry (e, struct dentry, elem));
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every name cached for the removed directory PARENT, whose
+   sector may be reused for a new one. */
+static void
+dcache_purge (block_sector_t parent)
+{
+  struct list_elem *e;
+
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); )
+  {
+    struct dentry *d = list_entry (e, struct dentry, lru_elem);
+    e = list_next (e);
+    if (d->parent == parent)
+      dcache_drop (d);
+  }
+  lock_release (&dcache_lock);
+}
 
 /* Creates a directory in the given SECTOR.  Returns true if successful, false
    on failure. */
@@ -101,6 +345,377 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns true if INODE holds a hashed directory */
+static bool
+dx_is_indexed (struct inode *inode)
+{
+  uint32_t magic;
+  return (inode_read_at (inode, &magic, sizeof magic,
+                         offsetof (struct dx_root, magic)) == sizeof magic
+          && magic == DX_ROOT_MAGIC);
+}
+
+/* Reads block BLOCK of directory INODE into BUF */
+static bool
+dx_read (struct inode *inode, uint32_t block, void *buf)
+{
+  return inode_read_at (inode, buf, BLOCK_SECTOR_SIZE,
+                        block * BLOCK_SECTOR_SIZE) == BLOCK_SECTOR_SIZE;
+}
+
+/* Writes SIZE bytes of BUF as block BLOCK of directory INODE */
+static bool
+dx_write (struct inode *inode, uint32_t block, const void *buf, off_t size)
+{
+  return inode_write_at (inode, buf, size,
+                         block * BLOCK_SECTOR_SIZE) == size;
+}
+
+/* Returns the byte offset of entry SLOT of leaf BLOCK */
+static off_t
+dx_entry_offset (uint32_t block, int slot)
+{
+  return block * BLOCK_SECTOR_SIZE + offsetof (struct dx_leaf, entries)
+    + slot * sizeof (struct dir_entry);
+}
+
+/* Returns the last of the COUNT ENTRIES whose hash is at most HASH */
+static struct dx_entry *
+dx_search (struct dx_entry *entries, int count, uint32_t hash)
+{
+  int lo = 0, hi = count - 1;
+
+  while (lo < hi)
+  {
+    int mid = (lo + hi + 1) / 2;
+    if (entries[mid].hash <= hash)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &entries[lo];
+}
+
+/* Follows the index of hashed directory INODE down to the leaf that
+   holds names hashing to HASH, recording the path in F */
+static bool
+dx_walk (struct inode *inode, uint32_t hash, struct dx_frame *f)
+{
+  if (!dx_read (inode, 0, &f->root) || f->root.count == 0)
+    return false;
+  f->root_at = dx_search (f->root.entries, f->root.count, hash);
+  f->node_at = NULL;
+  f->leaf_block = f->root_at->block;
+
+  if (f->root.levels > 0)
+  {
+    f->node_block = f->root_at->block;
+    if (!dx_read (inode, f->node_block, &f->node)
+        || f->node.magic != DX_NODE_MAGIC || f->node.count == 0)
+      return false;
+    f->node_at = dx_search (f->node.entries, f->node.count, hash);
+    f->leaf_block = f->node_at->block;
+  }
+  return true;
+}
+
+/* Inserts an entry for HASH and BLOCK into the COUNT ENTRIES just
+   after AT. There must be room for it. */
+static void
+dx_insert_entry (struct dx_entry *entries, uint16_t *count,
+                 struct dx_entry *at, uint32_t hash, uint32_t block)
+{
+  memmove (at + 2, at + 1, (entries + *count - (at + 1)) * sizeof *at);
+  at[1].hash = hash;
+  at[1].block = block;
+  (*count)++;
+}
+
+/* Links a new leaf BLOCK holding the names from HASH up into the
+   index next to the leaf F leads to, splitting the index as needed,
+   and writes the changed index blocks out. */
+static bool
+dx_link_leaf (struct inode *inode, struct dx_frame *f, uint32_t hash,
+              uint32_t block)
+{
+  if (f->root.levels == 0)
+  {
+    if (f->root.count < DX_ROOT_ENTRIES)
+    {
+      dx_insert_entry (f->root.entries, &f->root.count, f->root_at,
+                       hash, block);
+      return dx_write (inode, 0, &f->root, sizeof f->root);
+    }
+
+    /* Move the root's entries down into a node of their own */
+    f->node_block = f->root.blocks++;
+    f->node.magic = DX_NODE_MAGIC;
+    f->node.count = f->root.count;
+    f->node.unused = 0;
+    memcpy (f->node.entries, f->root.entries,
+            f->root.count * sizeof *f->root.entries);
+    f->node_at = f->node.entries + (f->root_at - f->root.entries);
+    f->root.levels = 1;
+    f->root.count = 1;
+    f->root.entries[0].hash = 0;
+    f->root.entries[0].block = f->node_block;
+    f->root_at = f->root.entries;
+  }
+
+  if (f->node.count < DX_NODE_ENTRIES)
+  {
+    dx_insert_entry (f->node.entries, &f->node.count, f->node_at,
+                     hash, block);
+    return (dx_write (inode, f->node_block, &f->node, sizeof f->node)
+            && dx_write (inode, 0, &f->root, sizeof f->root));
+  }
+  if (f->root.count >= DX_ROOT_ENTRIES)
+    return false;
+
+  /* Split the node, moving its upper half to a new block */
+  struct dx_node *upper = malloc (sizeof *upper);
+  if (upper == NULL)
+    return false;
+  int half = DX_NODE_ENTRIES / 2;
+  uint32_t upper_block = f->root.blocks++;
+  upper->magic = DX_NODE_MAGIC;
+  upper->count = f->node.count - half;
+  upper->unused = 0;
+  memcpy (upper->entries, f->node.entries + half,
+          upper->count * sizeof *upper->entries);
+  f->node.count = half;
+
+  if (f->node_at >= f->node.entries + half)
+    dx_insert_entry (upper->entries, &upper->count,
+                     upper->entries + (f->node_at - f->node.entries - half),
+                     hash, block);
+  else
+    dx_insert_entry (f->node.entries, &f->node.count, f->node_at,
+                     hash, block);
+  dx_insert_entry (f->root.entries, &f->root.count, f->root_at,
+                   upper->entries[0].hash, upper_block);
+
+  bool success = (dx_write (inode, upper_block, upper, sizeof *upper)
+                  && dx_write (inode, f->node_block, &f->node,
+                               sizeof f->node)
+                  && dx_write (inode, 0, &f->root, sizeof f->root));
+  free (upper);
+  return success;
+}
+
+/* Sorts the N entries of ES by name hash */
+static void
+dx_sort (struct dir_entry *es, uint32_t *hashes, int n)
+{
+  int i, j;
+
+  for (i = 1; i < n; i++)
+  {
+    struct dir_entry e = es[i];
+    uint32_t h = hashes[i];
+    for (j = i; j > 0 && hashes[j - 1] > h; j--)
+    {
+      es[j] = es[j - 1];
+      hashes[j] = hashes[j - 1];
+    }
+    es[j] = e;
+    hashes[j] = h;
+  }
+}
+
+/* Splits the full leaf F leads to, which holds the entries of
+   LEAF, to make room for a new entry E, and adds E. */
+static bool
+dx_split_leaf (struct inode *inode, struct dx_frame *f,
+               struct dx_leaf *leaf, const struct dir_entry *e)
+{
+  const int n = DX_LEAF_ENTRIES + 1;
+  struct dir_entry *es = malloc (n * sizeof *es);
+  uint32_t *hashes = malloc (n * sizeof *hashes);
+  struct dx_leaf *upper = calloc (1, sizeof *upper);
+  bool success = false;
+  int i, mid;
+
+  if (es == NULL || hashes == NULL || upper == NULL)
+    goto done;
+
+  memcpy (es, leaf->entries, DX_LEAF_ENTRIES * sizeof *es);
+  es[DX_LEAF_ENTRIES] = *e;
+  for (i = 0; i < n; i++)
+    hashes[i] = hash_string (es[i].name);
+  dx_sort (es, hashes, n);
+
+  /* Names with equal hashes have to stay in the same leaf */
+  for (mid = n / 2; mid < n && hashes[mid] == hashes[mid - 1]; mid++)
+    continue;
+  if (mid == n)
+    for (mid = n / 2; mid > 0 && hashes[mid] == hashes[mid - 1]; mid--)
+      continue;
+  if (mid == 0)
+    goto done;
+
+  /* Write the upper half to a new leaf, link it in, and only then
+     drop it from the old leaf so that lookups always find it */
+  uint32_t upper_block = f->root.blocks++;
+  upper->magic = DX_LEAF_MAGIC;
+  memcpy (upper->entries, es + mid, (n - mid) * sizeof *es);
+  memset (leaf->entries, 0, sizeof leaf->entries);
+  memcpy (leaf->entries, es, mid * sizeof *es);
+  success = (dx_write (inode, upper_block, upper, sizeof *upper)
+             && dx_link_leaf (inode, f, hashes[mid], upper_block)
+             && dx_write (inode, f->leaf_block, leaf, sizeof *leaf));
+
+done:
+  free (es);
+  free (hashes);
+  free (upper);
+  return success;
+}
+
+/* Searches hashed directory INODE for NAME, like lookup(). If ADD
+   is non-null, instead adds it under NAME if NAME is not there. */
+static bool
+dx_lookup (struct inode *inode, const char *name, struct dir_entry *ep,
+           off_t *ofsp, const struct dir_entry *add)
+{
+  struct dx_frame *f;
+  struct dx_leaf *leaf;
+  bool found = false;
+  int i, free_slot = -1;
+
+  /* "." and ".." are kept in the root */
+  if (!strcmp (name, ".") || !strcmp (name, ".."))
+  {
+    off_t ofs = name[1] == '\0' ? offsetof (struct dx_root, dot)
+                                : offsetof (struct dx_root, dotdot);
+    struct dir_entry e;
+    if (add != NULL
+        || inode_read_at (inode, &e, sizeof e, ofs) != sizeof e
+        || !e.in_use)
+      return false;
+    if (ep != NULL)
+      *ep = e;
+    if (ofsp != NULL)
+      *ofsp = ofs;
+    return true;
+  }
+
+  f = malloc (sizeof *f);
+  leaf = malloc (sizeof *leaf);
+  if (f == NULL || leaf == NULL
+      || !dx_walk (inode, hash_string (name), f)
+      || !dx_read (inode, f->leaf_block, leaf)
+      || leaf->magic != DX_LEAF_MAGIC)
+    goto done;
+
+  for (i = 0; i < DX_LEAF_ENTRIES; i++)
+  {
+    struct dir_entry *e = &leaf->entries[i];
+    if (!e->in_use)
+    {
+      if (free_slot < 0)
+        free_slot = i;
+    }
+    else if (!strcmp (name, e->name))
+    {
+      if (ep != NULL)
+        *ep = *e;
+      if (ofsp != NULL)
+        *ofsp = dx_entry_offset (f->leaf_block, i);
+      found = true;
+      break;
+    }
+  }
+
+  if (add != NULL)
+  {
+    if (found)
+      found = false;
+    else if (free_slot >= 0)
+      found = inode_write_at (inode, add, sizeof *add,
+                              dx_entry_offset (f->leaf_block, free_slot))
+        == sizeof *add;
+    else
+      found = dx_split_leaf (inode, f, leaf, add);
+  }
+
+done:
+  free (f);
+  free (leaf);
+  return found;
+}
+
+/* Rebuilds linear directory INODE as a hashed directory. On failure
+   INODE is left as it was, unless a disk error interrupts writing
+   the new blocks. */
+static bool
+dx_build (struct inode *inode)
+{
+  int n = inode_length (inode) / sizeof (struct dir_entry);
+  struct dir_entry *es = malloc (n * sizeof *es);
+  uint32_t *hashes = malloc (n * sizeof *hashes);
+  struct dx_root *root = calloc (1, sizeof *root);
+  struct dx_leaf *leaf = calloc (1, sizeof *leaf);
+  bool success = false;
+  int i, cnt;
+
+  if (es == NULL || hashes == NULL || root == NULL || leaf == NULL
+      || inode_read_at (inode, es, n * sizeof *es, 0)
+         != (off_t) (n * sizeof *es))
+    goto done;
+
+  /* Keep "." and "..", and pack the rest sorted by hash */
+  root->dot = es[0];
+  root->dotdot = es[1];
+  for (i = 2, cnt = 0; i < n; i++)
+    if (es[i].in_use)
+    {
+      es[cnt] = es[i];
+      hashes[cnt++] = hash_string (es[i].name);
+    }
+  dx_sort (es, hashes, cnt);
+
+  /* Cut the entries into leaves without splitting equal hashes */
+  root->magic = DX_ROOT_MAGIC;
+  root->blocks = 1;
+  for (i = 0; i < cnt || root->count == 0; )
+  {
+    int end = i + DX_LEAF_FILL < cnt ? i + DX_LEAF_FILL : cnt;
+    while (end < cnt && end > i && hashes[end] == hashes[end - 1])
+      end++;
+    if (end - i > DX_LEAF_ENTRIES || root->count == DX_ROOT_ENTRIES)
+      goto done;
+    root->entries[root->count].hash = root->count == 0 ? 0 : hashes[i];
+    root->entries[root->count].block = root->blocks++;
+    root->count++;
+    i = end;
+  }
+
+  /* Write the leaves from the last one down, so that running out of
+     space while extending the file leaves the old contents alone */
+  leaf->magic = DX_LEAF_MAGIC;
+  int end = cnt;
+  for (i = root->count - 1; i >= 0; i--)
+  {
+    int start = end;
+    while (start > 0 && hashes[start - 1] >= root->entries[i].hash)
+      start--;
+    memset (leaf->entries, 0, sizeof leaf->entries);
+    memcpy (leaf->entries, es + start, (end - start) * sizeof *es);
+    if (!dx_write (inode, root->entries[i].block, leaf, sizeof *leaf))
+      goto done;
+    end = start;
+  }
+  success = dx_write (inode, 0, root, sizeof *root);
+
+done:
+  free (es);
+  free (hashes);
+  free (root);
+  free (leaf);
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -116,6 +731,9 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (dx_is_indexed (dir->inode))
+    return dx_lookup (dir->inode, name, ep, ofsp, NULL);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -129,6 +747,26 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Resolves NAME in DIR through the dentry cache, storing the sector
+   of its inode in *SECTOR. Returns true if NAME exists. */
+static bool
+dir_lookup_sector (const struct dir *dir, const char *name,
+                   block_sector_t *sector)
+{
+  unsigned gen;
+  struct dir_entry e;
+
+  if (dcache_lookup (inode_get_inumber (dir->inode), name, sector, &gen))
+    return *sector != INODE_INVALID_BLOCK_SECTOR;
+
+  inode_lock_dir (dir->inode, false);
+  *sector = lookup (dir, name, &e, NULL) ? e.inode_sector
+                                         : INODE_INVALID_BLOCK_SECTOR;
+  dcache_insert (dir->inode, name, *sector, gen);
+  inode_unlock_dir (dir->inode, false);
+  return *sector != INODE_INVALID_BLOCK_SECTOR;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -137,14 +775,14 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  block_sector_t sector;
 
   ASSERT (dir != NULL);
 
   if (name == NULL)
     *inode = inode_open (inode_get_inumber (dir->inode));
-  else if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  else if (dir_lookup_sector (dir, name, &sector))
+    *inode = inode_open (sector);
   else
     *inode = NULL;
 
@@ -171,31 +809,59 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  lock_acquire (&dir->l);
+  inode_lock_dir (dir->inode, true);
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  e.in_use = true;
+  strlcpy (e.name, name, sizeof e.name);
+  e.inode_sector = inode_sector;
+
+  /* Hashed directories find the slot and check for NAME at once */
+  if (dx_is_indexed (dir->inode))
+  {
+    success = dx_lookup (dir->inode, name, NULL, NULL, &e);
     goto done;
+  }
 
-  /* Set OFS to offset of free slot.
+  /* Check that NAME is not in use, unless the dentry cache already
+     knows whether it is */
+  block_sector_t cached;
+  unsigned gen;
+  if (dcache_lookup (inode_get_inumber (dir->inode), name, &cached, &gen))
+  {
+    if (cached != INODE_INVALID_BLOCK_SECTOR)
+      goto done;
+  }
+  else if (lookup (dir, name, NULL, NULL))
+    goto done;
+
+  /* Set OFS to offset of free slot, starting from the inode's hint
+     rather than from the beginning.
      If there are no free slots, then it will be set to the
      current end-of-file.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
+  struct dir_entry slot;
+  for (ofs = inode_get_free_hint (dir->inode);
+       inode_read_at (dir->inode, &slot, sizeof slot, ofs) == sizeof slot;
+       ofs += sizeof slot) 
+    if (!slot.in_use)
       break;
 
   /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    inode_set_free_hint (dir->inode, ofs + sizeof e);
+
+  /* Switch to a hashed index once the directory gets big */
+  if (success && inode_length (dir->inode)
+                 > DIR_LINEAR_SECTORS * BLOCK_SECTOR_SIZE)
+    dx_build (dir->inode);
 done:
-  lock_release (&dir->l);
+  if (success)
+    dcache_invalidate (inode_get_inumber (dir->inode), name);
+  inode_unlock_dir (dir->inode, true);
   return success;
 }
 
@@ -213,7 +879,12 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  lock_acquire (&dir->l);
+  /* "." and ".." name DIR and its parent, whose entries the check for
+     emptiness below would lock a second time or in the wrong order */
+  if (!strcmp (name, ".") || !strcmp (name, ".."))
+    return false;
+
+  inode_lock_dir (dir->inode, true);
 
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
@@ -238,12 +909,26 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+  /* Remove inode.  Its blocks are freed once the last opener closes
+     it, but the name is already gone, so later opens fail.  If the
+     removal is refused, put the entry back as it was. */
+  if (!inode_remove (inode))
+  {
+    e.in_use = true;
+    inode_write_at (dir->inode, &e, sizeof e, ofs);
+    goto done;
+  }
+  if (inode_is_directory (inode))
+    dcache_purge (e.inode_sector);
 
-  /* Remove inode. */
-  success = inode_remove (inode);
+  if (ofs < inode_get_free_hint (dir->inode))
+    inode_set_free_hint (dir->inode, ofs);
+  success = true;
 
 done:
-  lock_release (&dir->l);
+  inode_unlock_dir (dir->inode, true);
   inode_close (inode);
   return success;
 }
@@ -253,23 +938,94 @@ done:
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  return dir_readdir_entry (dir, name, NULL, NULL);
+}
+
+/* Reads the next directory entry in DIR like dir_readdir(), also
+   storing the sector of its inode in *INUMBER and whether it is a
+   directory in *IS_DIR if they are non-null. */
+bool
+dir_readdir_entry (struct dir *dir, char name[NAME_MAX + 1],
+                   block_sector_t *inumber, bool *is_dir)
 {
   struct dir_entry e;
 
-  bool result = false;
   lock_acquire (&dir->l);
-  while (!result && 
-      inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock_dir (dir->inode, false);
+  bool result = dir_next (dir->inode, &dir->pos, &e);
+  inode_unlock_dir (dir->inode, false);
+  lock_release (&dir->l);
+  if (!result)
+    return false;
+
+  strlcpy (name, e.name, NAME_MAX + 1);
+  if (inumber != NULL)
+    *inumber = e.inode_sector;
+  if (is_dir != NULL)
+  {
+    struct inode *inode = inode_open (e.inode_sector);
+    *is_dir = inode != NULL && inode_is_directory (inode);
+    inode_close (inode);
+  }
+  return true;
+}
+
+/* Reads the first entry in use at or after byte offset *POS of
+   directory INODE into *EP and moves *POS past it. Offsets before
+   the first leaf of a hashed directory start at that leaf, so "."
+   and ".." are only returned for linear directories.
+   Returns false if there are no more entries. */
+static bool
+dir_next (struct inode *inode, off_t *pos, struct dir_entry *ep)
+{
+  if (!dx_is_indexed (inode))
   {
-    if (e.in_use)
+    while (inode_read_at (inode, ep, sizeof *ep, *pos) == sizeof *ep)
     {
-      strlcpy (name, e.name, NAME_MAX + 1);
-      result = true;
-    } 
-    dir->pos += sizeof e;
+      *pos += sizeof *ep;
+      if (ep->in_use)
+        return true;
+    }
+    return false;
   }
-  lock_release (&dir->l);
-  return result;
+
+  struct dx_leaf *leaf = malloc (sizeof *leaf);
+  uint32_t blocks;
+  bool found = false;
+
+  if (leaf == NULL
+      || inode_read_at (inode, &blocks, sizeof blocks,
+                        offsetof (struct dx_root, blocks)) != sizeof blocks)
+    goto done;
+
+  if (*pos < dx_entry_offset (1, 0))
+    *pos = dx_entry_offset (1, 0);
+
+  uint32_t block = *pos / BLOCK_SECTOR_SIZE;
+  off_t leaf_ofs = *pos % BLOCK_SECTOR_SIZE;
+  int slot = 0;
+  if (leaf_ofs > (off_t) offsetof (struct dx_leaf, entries))
+    slot = DIV_ROUND_UP (leaf_ofs - offsetof (struct dx_leaf, entries),
+                         sizeof *ep);
+  for (; !found && block < blocks; block++, slot = 0)
+  {
+    /* Skip index blocks */
+    if (!dx_read (inode, block, leaf) || leaf->magic != DX_LEAF_MAGIC)
+      continue;
+    for (; slot < DX_LEAF_ENTRIES; slot++)
+      if (leaf->entries[slot].in_use)
+      {
+        *ep = leaf->entries[slot];
+        *pos = dx_entry_offset (block, slot) + sizeof *ep;
+        found = true;
+        break;
+      }
+  }
+
+done:
+  free (leaf);
+  return found;
 }
 
 /* Gets the directory component of the given path. Returns a new string that
@@ -302,7 +1058,11 @@ dir_open_path (const char *path)
   block_sector_t sector = path_traverse (path, NULL);
   if (sector == INODE_INVALID_BLOCK_SECTOR) return NULL;
   struct dir *d = dir_open (inode_open (sector));
-  if (inode_is_removed (d->inode)) return NULL;
+  if (d != NULL && inode_is_removed (d->inode))
+  {
+    dir_close (d);
+    return NULL;
+  }
   return d;
 }
 
@@ -313,7 +1073,6 @@ path_traverse (char *path, struct thread *t)
   char *token, *save_ptr;
   bool found;
   struct dir dir;
-  struct dir_entry entry;
   block_sector_t sector;
 
   if (path == NULL) return thread_get_cwd ();
@@ -346,11 +1105,9 @@ path_traverse (char *path, struct thread *t)
       thread_leave_dir (t, dir.inode);
 
     /* Look up in current directory */
-    found = lookup (&dir, token, &entry, NULL);
+    found = dir_lookup_sector (&dir, token, &sector);
     if (found)
     {
-      sector = entry.inode_sector;
-
       /* Make thread enter the directory if applicable */
       if (t != NULL)
         thread_enter_dir (t, dir.inode);
@@ -392,17 +1149,13 @@ static size_t
 dir_size (struct dir *dir)
 {
   struct dir_entry e;
-  size_t ofs;
+  off_t ofs = 2 * sizeof e;
   size_t count = 0;
 
   ASSERT (dir != NULL);
-  lock_acquire (&dir->l);
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-  {
-    if (e.in_use)
-      count++;
-  }
-  lock_release (&dir->l);
-  return count - 2;
+  inode_lock_dir (dir->inode, false);
+  while (dir_next (dir->inode, &ofs, &e))
+    count++;
+  inode_unlock_dir (dir->inode, false);
+  return count;
 }
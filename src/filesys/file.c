@@ -4,12 +4,16 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Bytes read ahead of reads from a file advised ADV_SEQUENTIAL */
+#define FILE_READAHEAD_SEQUENTIAL (8 * BLOCK_SECTOR_SIZE)
+
 /* An open file. */
 struct file 
 {
   struct inode *inode;        /* File's inode. */
   off_t pos;                  /* Current position. */
   bool deny_write;            /* Has file_deny_write() been called? */
+  enum advice advice;         /* ADV_NORMAL, ADV_SEQUENTIAL or ADV_RANDOM */
   
   struct dir *dir;            /* Should only be non-null if the file
                                  is a directory */
@@ -29,6 +33,7 @@ file_open (struct inode *inode)
     if (inode_is_directory (inode)) 
       file->dir = dir_open (file->inode);
     file->deny_write = false;
+    file->advice = ADV_NORMAL;
     return file;
   }
   else
@@ -74,7 +79,8 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_advised (file, buffer, size, file->pos,
+                                        file->advice);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -87,7 +93,53 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  return file_read_advised (file, buffer, size, file_ofs, file->advice);
+}
+
+/* Like file_read_at(), but reads ahead as suits ADVICE rather than
+   FILE's own advice. */
+off_t
+file_read_advised (struct file *file, void *buffer, off_t size,
+                   off_t file_ofs, enum advice advice)
+{
+  off_t ahead = BLOCK_SECTOR_SIZE;
+  if (advice == ADV_SEQUENTIAL)
+    ahead = FILE_READAHEAD_SEQUENTIAL;
+  else if (advice == ADV_RANDOM)
+    ahead = 0;
+  return inode_read_ahead (file->inode, buffer, size, file_ofs, ahead);
+}
+
+/* Gives ADVICE about the SIZE bytes of FILE starting at START, or
+   about the rest of the file if SIZE is 0.  ADV_SEQUENTIAL and
+   ADV_RANDOM change how far reads from FILE read ahead, until
+   ADV_NORMAL restores the default; they apply to the whole file.
+   ADV_WILLNEED starts reading the range into the buffer cache in the
+   background, and ADV_DONTNEED makes its cached blocks the first to
+   be replaced.  Returns false if START or SIZE is negative or ADVICE
+   is unknown. */
+bool
+file_advise (struct file *file, off_t start, off_t size, enum advice advice)
+{
+  if (start < 0 || size < 0)
+    return false;
+  if (size == 0)
+    size = file_length (file) - start;
+
+  switch (advice)
+  {
+  case ADV_NORMAL:
+  case ADV_SEQUENTIAL:
+  case ADV_RANDOM:
+    file->advice = advice;
+    return true;
+  case ADV_WILLNEED:
+  case ADV_DONTNEED:
+    inode_advise (file->inode, start, size, advice == ADV_WILLNEED);
+    return true;
+  default:
+    return false;
+  }
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -120,6 +172,24 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from SRC into DST inside the file
+   system, starting at each file's current position, and advances
+   both positions by the number of bytes copied, which is returned.
+   Returns -1 if either file is a directory or both are the same
+   file. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  if (file_is_directory (dst) || file_is_directory (src)
+      || dst->inode == src->inode)
+    return -1;
+  off_t bytes_copied = inode_copy_at (dst->inode, dst->pos,
+                                      src->inode, src->pos, size);
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -198,3 +268,17 @@ file_readdir (struct file *file, char *name)
   bool success = dir_readdir (file->dir, name);
   return success;
 }
+
+/* Invokes readdir on the directory, also returning the inode number
+   of the entry and whether it is a directory */
+bool
+file_readdir_entry (struct file *file, char *name, int *inumber,
+                    bool *is_dir)
+{
+  block_sector_t sector;
+
+  if (file->dir == NULL) return false;
+  if (!dir_readdir_entry (file->dir, name, &sector, is_dir)) return false;
+  *inumber = sector;
+  return true;
+}
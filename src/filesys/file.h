@@ -6,6 +6,17 @@
 
 struct inode;
 
+/* How a file or mapping is going to be accessed, given to fadvise()
+   and madvise().  Must match the values in lib/user/syscall.h. */
+enum advice
+  {
+    ADV_NORMAL,                 /* No particular pattern. */
+    ADV_SEQUENTIAL,             /* Read in increasing order. */
+    ADV_RANDOM,                 /* Read in no useful order. */
+    ADV_WILLNEED,               /* Will be read soon. */
+    ADV_DONTNEED                /* Will not be read soon. */
+  };
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -15,8 +26,14 @@ struct inode *file_get_inode (struct file *);
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
+off_t file_read_advised (struct file *, void *, off_t size, off_t start,
+                         enum advice);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+
+/* Access pattern advice. */
+bool file_advise (struct file *, off_t start, off_t size, enum advice);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -33,5 +50,6 @@ int file_inumber (struct file *);
 /* Directory items. */
 bool file_is_directory (struct file *);
 bool file_readdir (struct file *, char *);
+bool file_readdir_entry (struct file *, char *, int *inumber, bool *is_dir);
 
 #endif /* filesys/file.h */
@@ -16,23 +16,39 @@ struct block *fs_device;
 static void do_format (void);
 
 /* Initializes the file system module.
-   If FORMAT is true, reformats the file system. */
+   If FORMAT is true, reformats the file system, giving its inodes
+   extent-based block maps if EXTENTS is true. Otherwise new inodes
+   use the same block map format as the existing root directory. */
 void
-filesys_init (bool format) 
+filesys_init (bool format, bool extents) 
 {
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  dir_init ();
   free_map_init ();
   if (!buffercache_init (BUFFERCACHE_SIZE))
     PANIC ("Could not create buffer cache, can't initialize file system.");
 
   if (format) 
+  {
+    inode_set_default_format (extents ? INODE_FORMAT_EXTENT
+                                      : INODE_FORMAT_INDEXED);
     do_format ();
+  }
 
   free_map_open ();
+
+  if (!format)
+  {
+    struct inode *root = inode_open (free_map_root_sector ());
+    if (root == NULL)
+      PANIC ("can't open root directory");
+    inode_set_default_format (inode_get_format (root));
+    inode_close (root);
+  }
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -40,6 +56,7 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  inode_done ();
   free_map_close ();
   buffercache_flush (true);
 }
@@ -96,6 +113,15 @@ filesys_mkdir (const char *path)
    or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *path)
+{
+  return file_open (filesys_lookup (path));
+}
+
+/* Opens the inode of the file or directory at PATH.
+   Returns the inode if successful or a null pointer otherwise.
+   The caller must close it. */
+struct inode *
+filesys_lookup (const char *path)
 {
   if (strlen (path) == 0) return NULL;
 
@@ -109,7 +135,7 @@ filesys_open (const char *path)
     dir_lookup (dir, basename, &inode);
   dir_close (dir);
 
-  return file_open (inode);
+  return inode;
 }
 
 /* Deletes the file named NAME.
@@ -7,11 +7,12 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
-void filesys_init (bool format);
+void filesys_init (bool format, bool extents);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 bool filesys_mkdir (const char *path);
 struct file *filesys_open (const char *name);
+struct inode *filesys_lookup (const char *name);
 bool filesys_remove (const char *name);
 
 #endif /* filesys/filesys.h */
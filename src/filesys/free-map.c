@@ -81,6 +81,35 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates CNT consecutive sectors, preferring HINT or the first
+   free run after it so that consecutive allocations stay contiguous
+   on disk, and stores the first into *SECTORP.
+   Returns true if successful, false if not enough consecutive
+   sectors were available or if the free_map file could not be
+   written. */
+bool
+free_map_allocate_near (block_sector_t hint, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  lock_acquire (&free_map_lock);
+  block_sector_t sector = BITMAP_ERROR;
+  if (hint < bitmap_size (free_map))
+    sector = bitmap_scan_and_flip (free_map, hint, cnt, false);
+  if (sector == BITMAP_ERROR)
+    sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR
+      && !free_map_write ())
+  {
+    bitmap_set_multiple (free_map, sector, cnt, false); 
+    sector = BITMAP_ERROR;
+  }
+  lock_release (&free_map_lock);
+
+  if (sector != BITMAP_ERROR)
+    *sectorp = sector;
+  return sector != BITMAP_ERROR;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
@@ -1,5 +1,6 @@
 #include "filesys/inode.h"
 #include <stdio.h>
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
@@ -7,7 +8,9 @@
 #include "filesys/buffercache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -28,26 +31,120 @@
 #define INODE_INDIRECT_INDEX_BASE INODE_CONSISTENT_BLOCKS
 #define INODE_DUBINDER_INDEX_BASE (INODE_CONSISTENT_BLOCKS+INODE_NUM_INDIRECT_BLOCKS)
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Extent tree geometry. The root node lives in the inode sector in
+   place of the sector table, every other node fills a whole sector */
+#define INODE_ROOT_EXTENTS 41
+#define EXTENT_NODE_ENTRIES 42
+
+/* Bytes of the on-disk inode, starting at LENGTH, that are mirrored
+   in the in-memory inode */
+#define INODE_HEADER_SIZE (sizeof (off_t) + 2 * sizeof (bool) \
+                           + sizeof (uint8_t))
+
+/* Files up to this size keep their data in the inode sector itself,
+   in place of the block map */
+#define INODE_INLINE_SIZE (INODE_NUM_BLOCKS * sizeof (block_sector_t))
+
+/* Number of closed inodes kept in memory for reuse.  A struct inode
+   comes from malloc's 256-byte arena, so a full cache pins at most
+   four kernel pages, too little for the kernel pool to be worth
+   reclaiming from palloc's failure path.  That path may also be
+   reached with file system locks held, where taking open_inodes_lock
+   would risk deadlock, so the cache is only given up when inode_open()
+   itself runs short. */
+#define INODE_CACHE_SIZE 64
+
+/* Most bytes inode_advise() reads ahead at once */
+#define INODE_READAHEAD_MAX (BUFFERCACHE_SIZE / 2 * BLOCK_SECTOR_SIZE)
+
+/* Open inodes hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;    /* Protects open_inodes and
+                                           unused_inodes */
+
+/* Inodes in open_inodes that nobody has open, least recently closed
+   first. They are kept so that reopening them skips the allocation
+   and the disk read, and are freed once there are more than
+   INODE_CACHE_SIZE of them or memory runs short. */
+static struct list unused_inodes;
+static size_t unused_inodes_cnt;
+
+/* Removed inodes whose last opener has closed them, waiting for the
+   reclaim daemon to free their blocks. */
+static struct list reclaim_list;
+static struct lock reclaim_lock;        /* Protects reclaim_list and
+                                           reclaim_busy */
+static struct condition reclaim_data;   /* Signaled on new work */
+static struct condition reclaim_idle;   /* Signaled when caught up */
+static bool reclaim_busy;               /* Daemon is freeing a batch */
+
+/* Run of sectors collected by the reclaim daemon that have not been
+   handed back to the free map yet. Only touched by the daemon. */
+static block_sector_t reclaim_run_start;
+static size_t reclaim_run_cnt;
+
+/* Block map layout given to newly created inodes */
+static enum inode_format default_format = INODE_FORMAT_INDEXED;
+
+/* A run of COUNT sectors starting at START that holds the logical
+   blocks beginning at BLOCK. In interior nodes of the extent tree
+   START is instead the sector of the child node holding every
+   extent from BLOCK up to the next entry's BLOCK, and COUNT is 0. */
+struct inode_extent
+{
+  uint32_t block;               /* First logical block covered. */
+  block_sector_t start;         /* First data sector or child node. */
+  uint32_t count;               /* Number of sectors in the run. */
+};
+
+/* Header at the start of every extent tree node */
+struct extent_header
+{
+  uint16_t entries;             /* Number of entries in use. */
+  uint16_t depth;               /* 0 for leaves, height otherwise. */
+};
+
+/* An extent tree node, sorted by BLOCK. Nodes other than the root
+   have EXTENT_NODE_ENTRIES slots, the root has INODE_ROOT_EXTENTS */
+struct extent_node
+{
+  struct extent_header header;
+  struct inode_extent entries[EXTENT_NODE_ENTRIES];
+};
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
 {
-  /* All of the inode blocks contains INODE_CONSISTENT_BLOCKS of 
-     blocks for the next level of indirection. The root block uses
-     INODE_CONSISTENT_BLOCKS + 1 for the singly indirect block and
-     INODE_CONSISTENT_BLOCKS + 2 for the doubly indirect block */
-  block_sector_t sectors[INODE_NUM_BLOCKS];
+  union
+  {
+    /* All of the inode blocks contains INODE_CONSISTENT_BLOCKS of 
+       blocks for the next level of indirection. The root block uses
+       INODE_CONSISTENT_BLOCKS + 1 for the singly indirect block and
+       INODE_CONSISTENT_BLOCKS + 2 for the doubly indirect block */
+    block_sector_t sectors[INODE_NUM_BLOCKS];
+
+    /* Root of the extent tree for INODE_FORMAT_EXTENT inodes */
+    struct
+    {
+      struct extent_header header;
+      struct inode_extent entries[INODE_ROOT_EXTENTS];
+    } extents;
+
+    /* File contents while INLINE_DATA is set */
+    uint8_t data[INODE_INLINE_SIZE];
+  };
   off_t length;                 /* File size in bytes. */
   bool directory;               /* true if this inode represents a directory */
-  uint8_t padding[3];           /* padding */
+  uint8_t format;               /* enum inode_format of the block map */
+  bool inline_data;             /* true if the data is stored in DATA */
+  uint8_t padding[1];           /* padding */
   unsigned magic;               /* Magic number. */
 };
 
 void inode_sector_free_map_fn (block_sector_t sector, bool meta);
+static void inode_reclaim_thread (void *aux);
 
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
@@ -60,13 +157,25 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode {
   block_sector_t disk_block;    /* Sector of this inode on disk*/
-  struct list_elem elem;        /* Element in inode list. */
-  off_t length;
+  struct hash_elem elem;        /* Element in open_inodes. */
+  struct list_elem lru_elem;    /* Element in unused_inodes if closed. */
+  off_t length;                 /* Mirrors INODE_HEADER_SIZE bytes */
   bool directory;               /* true if this inode represents a directory */
+  uint8_t format;               /* enum inode_format of the block map */
+  bool inline_data;             /* true if the data is in the inode sector */
+  struct inode_extent extent_cache; /* Last extent mapped, if count > 0 */
+  struct rwlock map_lock;       /* Shared for lookups in the block map,
+                                   exclusive to allocate blocks */
   int open_cnt;                 /* Number of openers. */
   bool removed;                 /* True if deleted, false otherwise. */
   int deny_write_cnt;           /* 0: writes ok, >0: deny writes. */
   int deny_remove_cnt;          /* 0: removes ok, >0: deny removes.*/
+  bool length_dirty;            /* LENGTH differs from the inode sector,
+                                   under LOCK */
+  struct rwlock dir_lock;       /* Directories: shared for lookups,
+                                   exclusive to change entries */
+  off_t free_hint;              /* Directories: no free entry before this
+                                   offset, under dir_lock. */
   struct lock lock;
 };
 
@@ -148,29 +257,386 @@ verify_sector (block_sector_t cur_sector, int index, bool
   return next_sector;
 }
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+/* Returns the number of entries an extent tree NODE of INODE can
+   hold */
+static int
+extent_capacity (const struct inode *inode, block_sector_t node)
+{
+  return node == inode->disk_block ? INODE_ROOT_EXTENTS
+                                   : EXTENT_NODE_ENTRIES;
+}
+
+/* Returns the byte offset of entry INDEX within an extent tree
+   node. The root node sits at the start of the inode sector, so
+   this is the same for every node. */
+static off_t
+extent_entry_offset (int index)
+{
+  return sizeof (struct extent_header)
+    + index * sizeof (struct inode_extent);
+}
+
+static void
+extent_node_read (const struct inode *inode, block_sector_t node,
+    struct extent_node *n)
+{
+  buffercache_read (node, METADATA, 0,
+                    extent_entry_offset (extent_capacity (inode, node)),
+                    n, INODE_INVALID_BLOCK_SECTOR);
+}
+
+static void
+extent_node_write (const struct inode *inode, block_sector_t node,
+    const struct extent_node *n)
+{
+  buffercache_write (node, METADATA, 0,
+                     extent_entry_offset (extent_capacity (inode, node)),
+                     n, INODE_INVALID_BLOCK_SECTOR);
+}
+
+/* Returns the index of the last entry of N whose block is at most
+   BLOCK, or -1 if BLOCK precedes every entry */
+static int
+extent_node_search (const struct extent_node *n, uint32_t block)
+{
+  int lo = 0, hi = n->header.entries;
+
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (n->entries[mid].block <= block)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/* Same as extent_node_search, but probes the entries of NODE one at
+   a time through the buffer cache instead of reading the whole
+   node */
+static int
+extent_search (block_sector_t node, int entries, uint32_t block)
+{
+  int lo = 0, hi = entries;
+
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    uint32_t mid_block;
+    buffercache_read (node, METADATA, extent_entry_offset (mid),
+                      sizeof mid_block, &mid_block,
+                      INODE_INVALID_BLOCK_SECTOR);
+    if (mid_block <= block)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/* Returns true if extent E maps logical BLOCK */
+static inline bool
+extent_contains (const struct inode_extent *e, uint32_t block)
+{
+  return e->count > 0 && block >= e->block && block - e->block < e->count;
+}
+
+/* Returns true and sets *SECTORP if the last extent INODE mapped
+   holds BLOCK. Readers of the block map share the cache, so it is
+   copied with interrupts off to get a consistent snapshot. */
+static bool
+extent_cache_lookup (struct inode *inode, uint32_t block,
+    block_sector_t *sectorp)
+{
+  enum intr_level old_level = intr_disable ();
+  struct inode_extent e = inode->extent_cache;
+  intr_set_level (old_level);
+
+  if (!extent_contains (&e, block))
+    return false;
+  *sectorp = e.start + (block - e.block);
+  return true;
+}
+
+/* Remembers E as the last extent INODE mapped */
+static void
+extent_cache_set (struct inode *inode, const struct inode_extent *e)
+{
+  enum intr_level old_level = intr_disable ();
+  inode->extent_cache = *e;
+  intr_set_level (old_level);
+}
+
+/* Walks the extent tree of INODE down to the leaf extent holding
+   BLOCK. Returns the sector holding BLOCK, or
+   INODE_INVALID_BLOCK_SECTOR if BLOCK is not allocated yet. */
 static block_sector_t
-byte_to_sector (struct inode *root, off_t pos, bool create) 
+extent_lookup (struct inode *inode, uint32_t block)
 {
-  ASSERT (root != NULL);
+  struct extent_header h;
+  struct inode_extent e;
+  block_sector_t node = inode->disk_block;
+  block_sector_t sector;
 
-  bool lock_held = lock_held_by_current_thread (&root->lock);
-  if (!lock_held)
-	lock_acquire (&root->lock);
+  if (extent_cache_lookup (inode, block, &sector))
+    return sector;
+
+  buffercache_read (node, METADATA, 0, sizeof h, &h,
+                    INODE_INVALID_BLOCK_SECTOR);
+  while (true)
+  {
+    int i = extent_search (node, h.entries, block);
+    if (h.depth == 0 && i < 0)
+      return INODE_INVALID_BLOCK_SECTOR;
+
+    /* Blocks before the first key of an index node live in its
+       leftmost child */
+    if (i < 0)
+      i = 0;
+    buffercache_read (node, METADATA, extent_entry_offset (i), sizeof e,
+                      &e, INODE_INVALID_BLOCK_SECTOR);
+    if (h.depth == 0)
+      break;
+
+    node = e.start;
+    buffercache_read (node, METADATA, 0, sizeof h, &h,
+                      INODE_INVALID_BLOCK_SECTOR);
+  }
+
+  if (!extent_contains (&e, block))
+    return INODE_INVALID_BLOCK_SECTOR;
+
+  extent_cache_set (inode, &e);
+  return e.start + (block - e.block);
+}
+
+/* Inserts E at index POS of node N, stored in sector NODE, and
+   writes the node back. A full root is pushed down into a new child
+   so that the tree grows by one level. Any other full node is split
+   in two, in which case *SPLIT is set to the index entry for the new
+   right sibling, which the caller must insert into the parent.
+   Returns false if a new node could not be allocated. */
+static bool
+extent_node_add (struct inode *inode, block_sector_t node,
+    struct extent_node *n, int pos, const struct inode_extent *e,
+    struct inode_extent *split)
+{
+  int capacity = extent_capacity (inode, node);
+  block_sector_t new_sector;
+
+  split->count = 0;
+  split->start = INODE_INVALID_BLOCK_SECTOR;
+
+  if (n->header.entries == capacity)
+  {
+    if (!free_map_allocate_near (node + 1, 1, &new_sector))
+      return false;
+
+    if (node == inode->disk_block)
+    {
+      /* Move the root's entries into a child, which has room for
+         one more entry than the root */
+      struct extent_node *root = malloc (sizeof *root);
+      if (root == NULL)
+      {
+        free_map_release (new_sector, 1);
+        return false;
+      }
+      root->header.entries = 1;
+      root->header.depth = n->header.depth + 1;
+      root->entries[0].block = 0;
+      root->entries[0].start = new_sector;
+      root->entries[0].count = 0;
+      extent_node_write (inode, node, root);
+      free (root);
+
+      node = new_sector;
+    } else {
+      /* Move the upper half of the entries into a new sibling */
+      struct extent_node *right = malloc (sizeof *right);
+      if (right == NULL)
+      {
+        free_map_release (new_sector, 1);
+        return false;
+      }
+      int half = n->header.entries / 2;
+      right->header.depth = n->header.depth;
+      right->header.entries = n->header.entries - half;
+      memcpy (right->entries, n->entries + half,
+              right->header.entries * sizeof *right->entries);
+      n->header.entries = half;
+
+      if (pos > half)
+      {
+        memmove (right->entries + pos - half + 1, right->entries + pos - half,
+                 (right->header.entries - (pos - half))
+                 * sizeof *right->entries);
+        right->entries[pos - half] = *e;
+        right->header.entries++;
+      }
+
+      split->block = right->entries[0].block;
+      split->start = new_sector;
+      extent_node_write (inode, new_sector, right);
+      free (right);
+
+      if (pos > half)
+      {
+        extent_node_write (inode, node, n);
+        return true;
+      }
+    }
+  }
+
+  memmove (n->entries + pos + 1, n->entries + pos,
+           (n->header.entries - pos) * sizeof *n->entries);
+  n->entries[pos] = *e;
+  n->header.entries++;
+  extent_node_write (inode, node, n);
+  return true;
+}
+
+/* Allocates CNT consecutive sectors for logical blocks BLOCK onward
+   in the extent subtree rooted at NODE, placing them right after
+   their logical predecessor on disk when possible so that they
+   extend an existing extent instead of adding a new one. None of
+   the blocks may be mapped yet, and none may lie past a mapped block
+   outside NODE's range. Stores the first new sector in *SECTORP. If
+   NODE had to be split, *SPLIT receives the index entry for its new
+   sibling, as in extent_node_add(). */
+static bool
+extent_allocate (struct inode *inode, block_sector_t node, uint32_t block,
+    uint32_t cnt, block_sector_t *sectorp, struct inode_extent *split)
+{
+  struct extent_node *n = malloc (sizeof *n);
+  bool success = false;
+
+  if (n == NULL)
+    return false;
+  extent_node_read (inode, node, n);
+
+  int i = extent_node_search (n, block);
+  if (n->header.depth > 0)
+  {
+    struct inode_extent child_split;
+    int child = i < 0 ? 0 : i;
+
+    /* The run must end before the next child's range begins */
+    if (child + 1 < n->header.entries
+        && block + cnt > n->entries[child + 1].block)
+    {
+      free (n);
+      return false;
+    }
+
+    success = extent_allocate (inode, n->entries[child].start, block, cnt,
+                               sectorp, &child_split);
+    split->count = 0;
+    split->start = INODE_INVALID_BLOCK_SECTOR;
+    if (success && child_split.start != INODE_INVALID_BLOCK_SECTOR)
+      success = extent_node_add (inode, node, n, child + 1, &child_split,
+                                 split);
+    free (n);
+    return success;
+  }
+
+  struct inode_extent *prev = i >= 0 ? &n->entries[i] : NULL;
+  struct inode_extent *next =
+    i + 1 < n->header.entries ? &n->entries[i + 1] : NULL;
+
+  /* Aim for the sector matching BLOCK's distance from a neighbor */
+  block_sector_t hint = inode->disk_block + 1;
+  if (prev != NULL)
+    hint = prev->start + (block - prev->block);
+  else if (next != NULL && next->start > next->block - block)
+    hint = next->start - (next->block - block);
+
+  block_sector_t sector;
+  if (!free_map_allocate_near (hint, cnt, &sector))
+  {
+    free (n);
+    return false;
+  }
+  split->count = 0;
+  split->start = INODE_INVALID_BLOCK_SECTOR;
+
+  if (prev != NULL && prev->block + prev->count == block
+      && prev->start + prev->count == sector)
+  {
+    /* Grow the preceding extent, merging with the next if the gap
+       between them is now closed */
+    prev->count += cnt;
+    if (next != NULL && next->block == block + cnt
+        && next->start == sector + cnt)
+    {
+      prev->count += next->count;
+      memmove (next, next + 1,
+               (n->header.entries - i - 2) * sizeof *n->entries);
+      n->header.entries--;
+    }
+    extent_cache_set (inode, prev);
+    extent_node_write (inode, node, n);
+    success = true;
+  } else if (next != NULL && next->block == block + cnt
+             && next->start == sector + cnt) {
+    /* Grow the following extent backwards */
+    next->block -= cnt;
+    next->start -= cnt;
+    next->count += cnt;
+    extent_cache_set (inode, next);
+    extent_node_write (inode, node, n);
+    success = true;
+  } else {
+    struct inode_extent e = {block, sector, cnt};
+    success = extent_node_add (inode, node, n, i + 1, &e, split);
+    if (success)
+      extent_cache_set (inode, &e);
+  }
+
+  if (success)
+    *sectorp = sector;
+  else
+    free_map_release (sector, cnt);
+  free (n);
+  return success;
+}
 
+/* Returns the sector holding byte offset POS of an extent-mapped
+   ROOT, allocating and zeroing it first if it is missing and CREATE
+   is true. */
+static block_sector_t
+extent_byte_to_sector (struct inode *root, off_t pos, bool create)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  uint32_t block = pos / BLOCK_SECTOR_SIZE;
+  struct inode_extent split;
+  block_sector_t sector = extent_lookup (root, block);
+
+  if (sector != INODE_INVALID_BLOCK_SECTOR || !create)
+    return sector;
+
+  if (!extent_allocate (root, root->disk_block, block, 1, &sector, &split))
+    return INODE_INVALID_BLOCK_SECTOR;
+  ASSERT (split.start == INODE_INVALID_BLOCK_SECTOR);
+
+  buffercache_write (sector, REGULAR, 0, BLOCK_SECTOR_SIZE, zeros,
+                     INODE_INVALID_BLOCK_SECTOR);
+  return sector;
+}
+
+/* Returns the sector holding byte offset POS of an indexed ROOT
+   through its direct, indirect and doubly indirect blocks,
+   allocating any missing blocks along the way if CREATE_FINAL is
+   true. */
+static block_sector_t
+indexed_byte_to_sector (struct inode *root, off_t pos, bool create_final)
+{
   block_sector_t indirect_sector = root->disk_block;
   block_sector_t dubindirect_sector = INODE_INVALID_BLOCK_SECTOR;
   block_sector_t result = INODE_INVALID_BLOCK_SECTOR;
   off_t cur_pos = pos;
 
-  /* If we did not get a sector index, but we are still within
-     the length of the file, we can create a new block */
-  bool within_length = pos < root->length;
-  bool create_final = create || within_length;
-
   /* Move down from the doubly indirect level if needed */
   if (cur_pos >= INODE_DUBINDER_OFFSET)
   {
@@ -181,6 +647,10 @@ byte_to_sector (struct inode *root, off_t pos, bool create)
     cur_pos %= INODE_DUBINDER_SIZE;
     dubindirect_sector = verify_sector (root->disk_block,
         dubinder_index, false, create_final);
+
+    /* Do not fall back to the singly indirect path below */
+    if (dubindirect_sector == INODE_INVALID_BLOCK_SECTOR)
+      return INODE_INVALID_BLOCK_SECTOR;
   }
 
   /* Move down from the singly indirect level if needed the first 
@@ -214,8 +684,44 @@ byte_to_sector (struct inode *root, off_t pos, bool create)
     result = verify_sector (indirect_sector, direct_index,
         true, create_final); 
   }
-  if (!lock_held)
-	lock_release (&root->lock);
+
+  return result;
+}
+
+/* Maps byte offset POS of ROOT through whichever block map format
+   it uses. ROOT's map_lock must be held, exclusively if CREATE is
+   true. */
+static block_sector_t
+inode_map_sector (struct inode *root, off_t pos, bool create)
+{
+  if (root->format == INODE_FORMAT_EXTENT)
+    return extent_byte_to_sector (root, pos, create);
+  else
+    return indexed_byte_to_sector (root, pos, create);
+}
+
+/* Returns the block device sector that contains byte offset POS
+   within INODE, allocating it first if CREATE is true.
+   Returns -1 if INODE does not contain data for a byte at offset
+   POS, which within the file's length means POS lies in a hole. */
+static block_sector_t
+byte_to_sector (struct inode *root, off_t pos, bool create) 
+{
+  ASSERT (root != NULL);
+  ASSERT (!root->inline_data);
+
+  /* Look the sector up alongside other readers first, and only
+     shut them out if it has to be allocated */
+  rwlock_acquire_read (&root->map_lock);
+  block_sector_t result = inode_map_sector (root, pos, false);
+  rwlock_release_read (&root->map_lock);
+
+  if (result == INODE_INVALID_BLOCK_SECTOR && create)
+  {
+    rwlock_acquire_write (&root->map_lock);
+    result = inode_map_sector (root, pos, true);
+    rwlock_release_write (&root->map_lock);
+  }
 
   return result;
 }
@@ -244,17 +750,61 @@ inode_sector_map_direct_helper (block_sector_t indirect_sector,
       bytes_traversed += BLOCK_SECTOR_SIZE;
     }
 
+  } else {
+    /* A missing indirect block is a hole over its whole range */
+    bytes_traversed += INODE_INDIRECT_SIZE;
   }
 
   return bytes_traversed;
 }
 
+/* Applies the mapping function to every data sector of the extent
+   subtree rooted at NODE, and to every node below NODE. */
+static void
+inode_sector_map_extent_helper (struct inode *root, block_sector_t node,
+  inode_sector_map_fn map_fn)
+{
+  struct extent_node *n = malloc (sizeof *n);
+  if (n == NULL)
+    return;
+  extent_node_read (root, node, n);
+
+  int i;
+  for (i = 0; i < n->header.entries; i++)
+  {
+    struct inode_extent *e = &n->entries[i];
+    if (n->header.depth > 0)
+    {
+      inode_sector_map_extent_helper (root, e->start, map_fn);
+      map_fn (e->start, true);
+    } else {
+      uint32_t j;
+      for (j = 0; j < e->count; j++)
+        map_fn (e->start + j, false);
+    }
+  }
+  free (n);
+}
+
 static void
 inode_sector_map (struct inode *root, inode_sector_map_fn map_fn)
 {
   ASSERT (root != NULL);
   ASSERT (root->disk_block != INODE_INVALID_BLOCK_SECTOR);
 
+  if (root->inline_data)
+  {
+    map_fn (root->disk_block, true);
+    return;
+  }
+
+  if (root->format == INODE_FORMAT_EXTENT)
+  {
+    inode_sector_map_extent_helper (root, root->disk_block, map_fn);
+    map_fn (root->disk_block, true);
+    return;
+  }
+
   off_t bytes_traversed = 0;
 
   /* Iterate over all direct blocks in the root level */
@@ -306,11 +856,101 @@ inode_sector_map (struct inode *root, inode_sector_map_fn map_fn)
 }
   
 
+/* Hashes an open inode by its sector */
+static unsigned
+inode_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->disk_block);
+}
+
+/* Orders open inodes by their sectors */
+static bool
+inode_hash_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                      void *aux UNUSED)
+{
+  struct inode *lhs = hash_entry (a, struct inode, elem);
+  struct inode *rhs = hash_entry (b, struct inode, elem);
+  return lhs->disk_block < rhs->disk_block;
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash_func, inode_hash_less_func, NULL);
+  lock_init (&open_inodes_lock);
+  list_init (&unused_inodes);
+  unused_inodes_cnt = 0;
+
+  /* Start the daemon that frees the blocks of removed inodes */
+  list_init (&reclaim_list);
+  lock_init (&reclaim_lock);
+  cond_init (&reclaim_data);
+  cond_init (&reclaim_idle);
+  reclaim_busy = false;
+  reclaim_run_cnt = 0;
+  if (thread_create ("inode_reclaim", PRI_DEFAULT, thread_get_cwd (),
+                     inode_reclaim_thread, NULL) == TID_ERROR)
+    PANIC ("Could not start inode reclaim thread");
+}
+
+/* Waits until the blocks of every removed and closed inode have
+   been returned to the free map. */
+void
+inode_done (void)
+{
+  lock_acquire (&reclaim_lock);
+  while (!list_empty (&reclaim_list) || reclaim_busy)
+    cond_wait (&reclaim_idle, &reclaim_lock);
+  lock_release (&reclaim_lock);
+}
+
+/* Frees closed inodes, oldest first, until at most KEEP remain.
+   open_inodes_lock must be held. */
+static void
+inode_cache_shrink (size_t keep)
+{
+  ASSERT (lock_held_by_current_thread (&open_inodes_lock));
+
+  while (unused_inodes_cnt > keep)
+  {
+    struct inode *inode = list_entry (list_pop_front (&unused_inodes),
+                                      struct inode, lru_elem);
+    unused_inodes_cnt--;
+    hash_delete (&open_inodes, &inode->elem);
+    free (inode);
+  }
+}
+
+/* Takes a new reference to INODE, found in open_inodes, taking it
+   off the list of unused inodes if nobody had it open.
+   open_inodes_lock must be held. */
+static struct inode *
+inode_get (struct inode *inode)
+{
+  ASSERT (lock_held_by_current_thread (&open_inodes_lock));
+
+  if (inode->open_cnt == 0)
+  {
+    list_remove (&inode->lru_elem);
+    unused_inodes_cnt--;
+  }
+  return inode_reopen (inode);
+}
+
+/* Sets the block map layout used by inode_create() from now on */
+void
+inode_set_default_format (enum inode_format format)
+{
+  default_format = format;
+}
+
+/* Returns the block map layout of INODE */
+enum inode_format
+inode_get_format (const struct inode *inode)
+{
+  return inode->format;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -330,12 +970,33 @@ inode_create (block_sector_t sector, off_t length, const bool directory)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  /* Drop any cached inode left over from a previous use of SECTOR */
+  struct inode key = {.disk_block = sector};
+  lock_acquire (&open_inodes_lock);
+  struct hash_elem *e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
+  {
+    struct inode *stale = hash_entry (e, struct inode, elem);
+    ASSERT (stale->open_cnt == 0);
+    list_remove (&stale->lru_elem);
+    unused_inodes_cnt--;
+    hash_delete (&open_inodes, &stale->elem);
+    free (stale);
+  }
+  lock_release (&open_inodes_lock);
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
   {
-    memset(disk_inode, INODE_INVALID_BLOCK_SECTOR, INODE_NUM_BLOCKS * sizeof(block_sector_t));
+    /* Small files start out with zeroed data in the inode itself */
+    disk_inode->inline_data = length <= (off_t) INODE_INLINE_SIZE;
+    /* Larger ones start out as a single hole; blocks are only
+       allocated as they are written */
+    if (!disk_inode->inline_data && default_format == INODE_FORMAT_INDEXED)
+      memset(disk_inode, INODE_INVALID_BLOCK_SECTOR, INODE_NUM_BLOCKS * sizeof(block_sector_t));
     disk_inode->length = length;
     disk_inode->directory = directory;
+    disk_inode->format = default_format;
     disk_inode->magic = INODE_MAGIC;
     int wrote = buffercache_write (sector, METADATA, 0, BLOCK_SECTOR_SIZE,
                                    disk_inode, INODE_INVALID_BLOCK_SECTOR);
@@ -351,51 +1012,142 @@ inode_create (block_sector_t sector, off_t length, const bool directory)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct hash_elem *e;
   struct inode *inode;
+  struct inode key = {.disk_block = sector};
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->disk_block == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  lock_acquire (&open_inodes_lock);
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
+  {
+    inode = inode_get (hash_entry (e, struct inode, elem));
+    lock_release (&open_inodes_lock);
+    return inode;
+  }
+  lock_release (&open_inodes_lock);
 
-  /* Allocate memory. */
+  /* Allocate memory, giving up the cached inodes if we are short. */
   inode = malloc (sizeof *inode);
+  if (inode == NULL)
+  {
+    lock_acquire (&open_inodes_lock);
+    inode_cache_shrink (0);
+    lock_release (&open_inodes_lock);
+    inode = malloc (sizeof *inode);
+  }
   if (inode == NULL)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->disk_block = sector;
-  /* Read length and directory flag from block */
+  /* Read length, directory flag, format and inline flag from block */
   int read = buffercache_read (sector, METADATA,
                                offsetof (struct inode_disk, length),
-                               sizeof (off_t) + sizeof (bool),
+                               INODE_HEADER_SIZE,
                                &inode->length,
                                INODE_INVALID_BLOCK_SECTOR);
-  if (read != (sizeof (off_t) + sizeof (bool)))
+  if (read != INODE_HEADER_SIZE)
   {
     free(inode);
     return NULL;
   }
+  inode->extent_cache.count = 0;
+  rwlock_init (&inode->map_lock);
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->deny_remove_cnt = 0;
   inode->removed = false;
+  inode->length_dirty = false;
+  rwlock_init (&inode->dir_lock);
+  inode->free_hint = 0;
   lock_init (&inode->lock);
+
+  /* Publish the inode, unless another thread opened it while we were
+     reading from disk */
+  lock_acquire (&open_inodes_lock);
+  e = hash_insert (&open_inodes, &inode->elem);
+  if (e != NULL)
+  {
+    free (inode);
+    inode = inode_get (hash_entry (e, struct inode, elem));
+  }
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
+/* Hands the run of sectors collected so far back to the free map */
+static void
+inode_reclaim_flush (void)
+{
+  if (reclaim_run_cnt > 0)
+    free_map_release (reclaim_run_start, reclaim_run_cnt);
+  reclaim_run_cnt = 0;
+}
 
+/* Frees SECTOR, batching it with the sectors freed just before it
+   so that the free map is updated once per contiguous run */
 void inode_sector_free_map_fn (block_sector_t sector, bool meta UNUSED)
 {
-  free_map_release (sector, 1);
+  if (reclaim_run_cnt > 0)
+  {
+    if (sector == reclaim_run_start + reclaim_run_cnt)
+    {
+      reclaim_run_cnt++;
+      return;
+    }
+    if (sector + 1 == reclaim_run_start)
+    {
+      reclaim_run_start--;
+      reclaim_run_cnt++;
+      return;
+    }
+  }
+  inode_reclaim_flush ();
+  reclaim_run_start = sector;
+  reclaim_run_cnt = 1;
+}
+
+/**
+ * Daemon thread that frees the blocks of removed inodes once their
+ * last opener has closed them, so that closing a large removed file
+ * does not stall the closing process.
+ */
+static void
+inode_reclaim_thread (void *aux UNUSED)
+{
+  struct list working_list;
+
+  list_init (&working_list);
+
+  while (true)
+  {
+    /* Wait for removed inodes */
+    lock_acquire (&reclaim_lock);
+    if (reclaim_busy)
+    {
+      reclaim_busy = false;
+      cond_broadcast (&reclaim_idle, &reclaim_lock);
+    }
+    while (list_empty (&reclaim_list))
+      cond_wait (&reclaim_data, &reclaim_lock);
+
+    /* Take the whole batch so closers don't block on us */
+    while (!list_empty (&reclaim_list))
+      list_push_back (&working_list, list_pop_front (&reclaim_list));
+    reclaim_busy = true;
+
+    lock_release (&reclaim_lock);
+
+    while (!list_empty (&working_list))
+    {
+      struct inode *inode = list_entry (list_pop_front (&working_list),
+                                        struct inode, lru_elem);
+      inode_sector_map (inode, inode_sector_free_map_fn);
+      free (inode);
+    }
+    inode_reclaim_flush ();
+  }
 }
 
 /* Reopens and returns INODE. */
@@ -416,9 +1168,10 @@ inode_get_inumber (const struct inode *inode)
   return inode->disk_block;
 }
 
-/* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+/* Closes INODE, writing its length back to disk if it has grown.
+   If this was the last reference to INODE, keeps it among the
+   unused inodes for a later inode_open(), unless INODE was removed,
+   in which case its memory and blocks are freed. */
 void
 inode_close (struct inode *inode) 
 {
@@ -426,36 +1179,144 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
+  /* Write back the length before taking the global lock.  It is
+     written under LOCK so that a stale length cannot overwrite a
+     newer one written by a concurrent closer. */
+  lock_acquire (&inode->lock);
+  if (inode->length_dirty && !inode->removed)
+  {
+    buffercache_write (inode->disk_block, METADATA,
+                       offsetof (struct inode_disk, length),
+                       sizeof inode->length, &inode->length,
+                       INODE_INVALID_BLOCK_SECTOR);
+    inode->length_dirty = false;
+  }
+  lock_release (&inode->lock);
+
+  lock_acquire (&open_inodes_lock);
   lock_acquire (&inode->lock);
-  inode->open_cnt--;
+  bool last = --inode->open_cnt == 0;
   lock_release (&inode->lock);
   /* Release resources if this was the last opener. */
-  if (inode->open_cnt == 0)
+  if (last)
   {
-    /* Remove from inode list and release lock. */
-    list_remove (&inode->elem);
-
-    /* Deallocate blocks if removed. */
-    if (inode->removed) 
+    /* Keep the inode around for reuse unless it is going away */
+    if (!inode->removed)
     {
-      inode_sector_map (inode, inode_sector_free_map_fn);
+      list_push_back (&unused_inodes, &inode->lru_elem);
+      unused_inodes_cnt++;
+      inode_cache_shrink (INODE_CACHE_SIZE);
+      lock_release (&open_inodes_lock);
+      return;
     }
-    buffercache_write (inode->disk_block, METADATA,
-                       offsetof (struct inode_disk, length), sizeof (off_t) +
-                       sizeof (bool), &inode->length,
-                       INODE_INVALID_BLOCK_SECTOR);
-    free (inode); 
+    hash_delete (&open_inodes, &inode->elem);
+    lock_release (&open_inodes_lock);
+
+    /* Leave deallocating the blocks to the reclaim daemon */
+    lock_acquire (&reclaim_lock);
+    list_push_back (&reclaim_list, &inode->lru_elem);
+    cond_signal (&reclaim_data, &reclaim_lock);
+    lock_release (&reclaim_lock);
+  } else {
+    lock_release (&open_inodes_lock);
   }
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
-   has it open. */
+   has it open.  Returns false if removing INODE is denied. */
 bool
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
-  if (inode->deny_remove_cnt > 0 && !inode->removed) return false;
-  inode->removed = true;
+  bool success;
+
+  lock_acquire (&inode->lock);
+  success = inode->deny_remove_cnt == 0 || inode->removed;
+  if (success)
+    inode->removed = true;
+  lock_release (&inode->lock);
+  return success;
+}
+
+/* Returns true if INODE still keeps its data in the inode sector.
+   The flag is read under map_lock, which inode_migrate_inline() holds
+   while it publishes the block map, so a false result means the map
+   is complete.  An inode never becomes inline again, so the answer
+   cannot go stale once it is false. */
+static bool
+inode_is_inline (struct inode *inode)
+{
+  rwlock_acquire_read (&inode->map_lock);
+  bool result = inode->inline_data;
+  rwlock_release_read (&inode->map_lock);
+  return result;
+}
+
+/* Moves the contents of an inline INODE out of its inode sector into
+   a data block, so that it can grow past INODE_INLINE_SIZE bytes.
+   The block is allocated and written, and the map pointing at it is
+   built, before the inode sector changes, so a failure leaves INODE
+   inline with its data intact.  The map and the cleared flag are then
+   published together under map_lock.  INODE's lock must be held.
+   Returns false if memory or disk allocation fails. */
+static bool
+inode_migrate_inline (struct inode *inode)
+{
+  ASSERT (lock_held_by_current_thread (&inode->lock));
+  ASSERT (inode->inline_data);
+  ASSERT (INODE_INLINE_SIZE <= BLOCK_SECTOR_SIZE);
+
+  uint8_t *block = calloc (1, BLOCK_SECTOR_SIZE);
+  if (block == NULL)
+    return false;
+
+  /* Everything that fits inline fits in one data block */
+  block_sector_t sector = INODE_INVALID_BLOCK_SECTOR;
+  if (inode->length > 0)
+  {
+    buffercache_read (inode->disk_block, METADATA, 0, inode->length, block,
+                      INODE_INVALID_BLOCK_SECTOR);
+    if (!free_map_allocate (1, &sector))
+    {
+      free (block);
+      return false;
+    }
+    if (buffercache_write (sector, REGULAR, 0, BLOCK_SECTOR_SIZE, block,
+                           INODE_INVALID_BLOCK_SECTOR) != BLOCK_SECTOR_SIZE)
+    {
+      free_map_release (sector, 1);
+      free (block);
+      return false;
+    }
+  }
+
+  /* Build the block map that replaces the data */
+  if (inode->format == INODE_FORMAT_EXTENT)
+  {
+    struct extent_node *root = (struct extent_node *) block;
+    memset (block, 0, INODE_INLINE_SIZE);
+    if (sector != INODE_INVALID_BLOCK_SECTOR)
+    {
+      root->header.entries = 1;
+      root->entries[0].block = 0;
+      root->entries[0].start = sector;
+      root->entries[0].count = 1;
+    }
+  } else {
+    memset (block, (uint8_t) INODE_INVALID_BLOCK_SECTOR, INODE_INLINE_SIZE);
+    ((block_sector_t *) block)[0] = sector;
+  }
+
+  rwlock_acquire_write (&inode->map_lock);
+  buffercache_write (inode->disk_block, METADATA, 0, INODE_INLINE_SIZE,
+                     block, INODE_INVALID_BLOCK_SECTOR);
+  inode->inline_data = false;
+  buffercache_write (inode->disk_block, METADATA,
+                     offsetof (struct inode_disk, inline_data), sizeof (bool),
+                     &inode->inline_data, INODE_INVALID_BLOCK_SECTOR);
+  rwlock_release_write (&inode->map_lock);
+
+  free (block);
   return true;
 }
 
@@ -463,17 +1324,47 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  return inode_read_ahead (inode, buffer, size, offset, BLOCK_SECTOR_SIZE);
+}
+
+/* Like inode_read_at(), but starts asynchronous reads of the blocks in
+   the AHEAD bytes after the data read.  With AHEAD 0 nothing is read
+   ahead. */
+off_t
+inode_read_ahead (struct inode *inode, void *buffer_, off_t size,
+                  off_t offset, off_t ahead)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
+  /* Small files are read straight out of the inode sector. The lock
+     keeps the data from being migrated out from under us. */
+  if (inode_is_inline (inode))
+  {
+    lock_acquire (&inode->lock);
+    if (inode->inline_data)
+    {
+      if (offset < inode->length)
+      {
+        bytes_read = inode->length - offset;
+        if (size < bytes_read)
+          bytes_read = size;
+        bytes_read = buffercache_read (inode->disk_block, METADATA, offset,
+                                       bytes_read, buffer,
+                                       INODE_INVALID_BLOCK_SECTOR);
+      }
+      lock_release (&inode->lock);
+      return bytes_read;
+    }
+    lock_release (&inode->lock);
+  }
+
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
       block_sector_t sector_idx = byte_to_sector (inode, offset, false);
-      if (sector_idx == INODE_INVALID_BLOCK_SECTOR) break;
-
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -486,11 +1377,18 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      /* Read chunk from this sector */
-      int read = buffercache_read (sector_idx, REGULAR, sector_ofs,
-                                   chunk_size, buffer + bytes_read,
-                                   byte_to_sector (inode, offset+chunk_size,
-                                                   false));
+      /* Read chunk from this sector. Holes were never written and
+         read back as zeros. */
+      int read = chunk_size;
+      if (sector_idx == INODE_INVALID_BLOCK_SECTOR)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        read = buffercache_read (sector_idx, REGULAR, sector_ofs,
+                                 chunk_size, buffer + bytes_read,
+                                 ahead > 0
+                                 ? byte_to_sector (inode, offset+chunk_size,
+                                                   false)
+                                 : INODE_INVALID_BLOCK_SECTOR);
       /* Advance. */
       size -= read;
       offset += read;
@@ -498,9 +1396,45 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (read != chunk_size) break;
     }
 
+  /* The loop already read ahead the block after each chunk */
+  if (ahead > BLOCK_SECTOR_SIZE)
+    inode_advise (inode, offset + BLOCK_SECTOR_SIZE,
+                  ahead - BLOCK_SECTOR_SIZE, true);
+
   return bytes_read;
 }
 
+/* Starts asynchronous reads of the blocks backing the SIZE bytes of
+   INODE at OFFSET that are not cached yet, or if WILLNEED is false,
+   makes their cached blocks the first to be replaced.  Holes and
+   data kept in the inode sector are skipped.  At most half of the
+   buffer cache is read ahead, so the blocks do not replace each
+   other before they are used. */
+void
+inode_advise (struct inode *inode, off_t offset, off_t size, bool willneed)
+{
+  if (offset < 0 || size <= 0 || inode_is_inline (inode))
+    return;
+
+  off_t end = inode_length (inode);
+  if (size < end - offset)
+    end = offset + size;
+  if (willneed && end - offset > INODE_READAHEAD_MAX)
+    end = offset + INODE_READAHEAD_MAX;
+
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+  {
+    block_sector_t sector = byte_to_sector (inode, offset, false);
+    if (sector == INODE_INVALID_BLOCK_SECTOR)
+      continue;
+    if (willneed)
+      buffercache_readahead (sector);
+    else
+      buffercache_release (sector);
+  }
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
@@ -516,6 +1450,36 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
+  /* Write small files into the inode sector, moving the data out to
+     blocks once it no longer fits */
+  if (inode_is_inline (inode))
+  {
+    lock_acquire (&inode->lock);
+    if (inode->inline_data && offset + size <= (off_t) INODE_INLINE_SIZE)
+    {
+      /* Zero the gap between the old end of file and OFFSET */
+      static const uint8_t zeros[INODE_INLINE_SIZE];
+      if (offset > inode->length)
+        buffercache_write (inode->disk_block, METADATA, inode->length,
+                           offset - inode->length, zeros,
+                           INODE_INVALID_BLOCK_SECTOR);
+      bytes_written = buffercache_write (inode->disk_block, METADATA, offset,
+                                         size, buffer,
+                                         INODE_INVALID_BLOCK_SECTOR);
+      if (offset + bytes_written > inode->length)
+      {
+        inode->length = offset + bytes_written;
+        inode->length_dirty = true;
+      }
+      lock_release (&inode->lock);
+      return bytes_written;
+    }
+    bool migrated = !inode->inline_data || inode_migrate_inline (inode);
+    lock_release (&inode->lock);
+    if (!migrated)
+      return 0;
+  }
+
   while (size > 0) 
   {
     /* Sector to write, starting byte offset within sector. */
@@ -547,13 +1511,165 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   bool lock_held = lock_held_by_current_thread (&inode->lock);
   if (!lock_held)
 	lock_acquire (&inode->lock);
-  if (offset + bytes_written > inode->length) inode->length = offset;
+  if (offset + bytes_written > inode->length)
+  {
+    inode->length = offset;
+    inode->length_dirty = true;
+  }
   if (!lock_held)
 	lock_release (&inode->lock);
 
   return bytes_written;
 }
 
+/* Allocates the missing blocks that back the SIZE bytes at OFFSET of
+   extent-mapped INODE as a few long runs instead of one sector at a
+   time. Every new block is zeroed before the map_lock is released, so
+   a concurrent reader, or a later extension past a copy that stopped
+   early, sees zeros rather than whatever a freed sector held. Does
+   nothing for other layouts, which inode_write_at() fills in block by
+   block. */
+static void
+inode_reserve (struct inode *inode, off_t offset, off_t size)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  uint32_t first = offset / BLOCK_SECTOR_SIZE;
+  uint32_t end = DIV_ROUND_UP (offset + size, BLOCK_SECTOR_SIZE);
+  uint32_t block = first;
+
+  if (inode->format != INODE_FORMAT_EXTENT || inode_is_inline (inode))
+    return;
+
+  rwlock_acquire_write (&inode->map_lock);
+  while (block < end)
+  {
+    /* Find the next run of missing blocks */
+    if (extent_lookup (inode, block) != INODE_INVALID_BLOCK_SECTOR)
+    {
+      block++;
+      continue;
+    }
+    uint32_t cnt = 1;
+    while (block + cnt < end
+           && extent_lookup (inode, block + cnt) == INODE_INVALID_BLOCK_SECTOR)
+      cnt++;
+
+    /* Take the longest piece of it the free map has in one run */
+    block_sector_t sector;
+    struct inode_extent split;
+    while (cnt > 0 && !extent_allocate (inode, inode->disk_block, block, cnt,
+                                        &sector, &split))
+      cnt /= 2;
+    if (cnt == 0)
+      break;
+    ASSERT (split.start == INODE_INVALID_BLOCK_SECTOR);
+
+    uint32_t i;
+    for (i = 0; i < cnt; i++)
+      buffercache_write (sector + i, REGULAR, 0, BLOCK_SECTOR_SIZE, zeros,
+                         INODE_INVALID_BLOCK_SECTOR);
+    block += cnt;
+  }
+  rwlock_release_write (&inode->map_lock);
+}
+
+/* Copies SIZE bytes at SRC_OFS of SRC into DST at DST_OFS without
+   passing them through a caller's buffer. Sectors move between
+   buffer cache blocks, holes in SRC are written as zeros, and DST's
+   missing blocks are allocated up front. Returns the number of bytes
+   copied, which may be less than SIZE if SRC ends first or DST cannot
+   grow. SRC and DST must not be the same inode. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+               off_t src_ofs, off_t size)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  off_t bytes_copied = 0;
+
+  ASSERT (dst != src);
+
+  if (dst->deny_write_cnt)
+    return 0;
+  if (size > inode_length (src) - src_ofs)
+    size = inode_length (src) - src_ofs;
+  if (size <= 0)
+    return 0;
+
+  /* Inline data lives in the inode sector, so copy small files the
+     ordinary way */
+  bool dst_inline = inode_is_inline (dst);
+  if (inode_is_inline (src)
+      || (dst_inline && dst_ofs + size <= (off_t) INODE_INLINE_SIZE))
+  {
+    uint8_t buffer[BLOCK_SECTOR_SIZE];
+    while (size > 0)
+    {
+      off_t chunk_size = size < BLOCK_SECTOR_SIZE ? size : BLOCK_SECTOR_SIZE;
+      off_t read = inode_read_at (src, buffer, chunk_size, src_ofs);
+      off_t wrote = inode_write_at (dst, buffer, read, dst_ofs);
+      size -= wrote;
+      src_ofs += wrote;
+      dst_ofs += wrote;
+      bytes_copied += wrote;
+      if (read != chunk_size || wrote != read) break;
+    }
+    return bytes_copied;
+  }
+  if (dst_inline)
+  {
+    lock_acquire (&dst->lock);
+    bool migrated = !dst->inline_data || inode_migrate_inline (dst);
+    lock_release (&dst->lock);
+    if (!migrated)
+      return 0;
+  }
+
+  inode_reserve (dst, dst_ofs, size);
+
+  while (size > 0)
+  {
+    block_sector_t dst_sector = byte_to_sector (dst, dst_ofs, true);
+    if (dst_sector == INODE_INVALID_BLOCK_SECTOR) break;
+    block_sector_t src_sector = byte_to_sector (src, src_ofs, false);
+    int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+    int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+
+    /* Bytes left in either sector, and in the copy */
+    int chunk_size = BLOCK_SECTOR_SIZE - (dst_sector_ofs > src_sector_ofs
+                                          ? dst_sector_ofs : src_sector_ofs);
+    if (size < chunk_size)
+      chunk_size = size;
+
+    int copied;
+    if (src_sector == INODE_INVALID_BLOCK_SECTOR)
+      copied = buffercache_write (dst_sector, REGULAR, dst_sector_ofs,
+                                  chunk_size, zeros,
+                                  INODE_INVALID_BLOCK_SECTOR);
+    else
+      copied = buffercache_copy (dst_sector, dst_sector_ofs, src_sector,
+                                 src_sector_ofs, chunk_size,
+                                 byte_to_sector (src, src_ofs + chunk_size,
+                                                 false));
+    /* Advance. */
+    size -= copied;
+    src_ofs += copied;
+    dst_ofs += copied;
+    bytes_copied += copied;
+    if (copied != chunk_size) break;
+  }
+
+  /* Handle file extension */
+  lock_acquire (&dst->lock);
+  if (dst_ofs > dst->length)
+  {
+    dst->length = dst_ofs;
+    dst->length_dirty = true;
+  }
+  lock_release (&dst->lock);
+
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -597,6 +1713,47 @@ bool inode_is_removed (const struct inode *i)
   return i->removed;
 }
 
+/* Locks the entries of directory INODE, which are shared by every
+   struct dir open on it: exclusively if WRITE is true, to add or
+   remove entries, and otherwise shared, to look them up. */
+void
+inode_lock_dir (struct inode *inode, bool write)
+{
+  if (write)
+    rwlock_acquire_write (&inode->dir_lock);
+  else
+    rwlock_acquire_read (&inode->dir_lock);
+}
+
+/* Releases the lock taken by inode_lock_dir(). */
+void
+inode_unlock_dir (struct inode *inode, bool write)
+{
+  if (write)
+    rwlock_release_write (&inode->dir_lock);
+  else
+    rwlock_release_read (&inode->dir_lock);
+}
+
+/* Returns the offset below which directory INODE is known to have no
+   free entries.  Its entries must be locked for writing, so that two
+   adds cannot take the same free slot. */
+off_t
+inode_get_free_hint (const struct inode *inode)
+{
+  ASSERT (rwlock_held_by_current_thread (&inode->dir_lock));
+  return inode->free_hint;
+}
+
+/* Sets the offset below which directory INODE is known to have no
+   free entries.  Its entries must be locked for writing. */
+void
+inode_set_free_hint (struct inode *inode, off_t ofs)
+{
+  ASSERT (rwlock_held_by_current_thread (&inode->dir_lock));
+  inode->free_hint = ofs;
+}
+
 void inode_deny_remove (struct inode *inode)
 {
   lock_acquire (&inode->lock);
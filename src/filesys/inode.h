@@ -7,9 +7,20 @@
 
 #define INODE_INVALID_BLOCK_SECTOR (block_sector_t)-1
 
+/* Block map layouts an on-disk inode may use. */
+enum inode_format
+{
+  INODE_FORMAT_INDEXED,         /* Direct, indirect and doubly indirect. */
+  INODE_FORMAT_EXTENT           /* Tree of (start, length) extents. */
+};
+
 struct bitmap;
+struct inode;
 
 void inode_init (void);
+void inode_done (void);
+void inode_set_default_format (enum inode_format);
+enum inode_format inode_get_format (const struct inode *);
 bool inode_create (block_sector_t, off_t, bool);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
@@ -17,7 +28,12 @@ block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 bool inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_ahead (struct inode *, void *, off_t size, off_t offset,
+                        off_t ahead);
+void inode_advise (struct inode *, off_t offset, off_t size, bool willneed);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+                     off_t src_ofs, off_t size);
 
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
@@ -28,5 +44,9 @@ void inode_allow_remove (struct inode *);
 off_t inode_length (const struct inode *);
 bool inode_is_directory (const struct inode *);
 bool inode_is_removed (const struct inode *i);
+void inode_lock_dir (struct inode *, bool write);
+void inode_unlock_dir (struct inode *, bool write);
+off_t inode_get_free_hint (const struct inode *);
+void inode_set_free_hint (struct inode *, off_t);
 
 #endif /* filesys/inode.h */
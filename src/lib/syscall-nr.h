@@ -28,7 +28,24 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_GETDENTS,               /* Reads a batch of directory entries. */
+    SYS_STAT,                   /* Obtains information about a path. */
+    SYS_FSTAT,                  /* Obtains information about a fd. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copy between files in the kernel. */
+    SYS_AIO_SETUP,              /* Register an asynchronous I/O ring. */
+    SYS_AIO_SUBMIT,             /* Submit and await asynchronous I/O. */
+    SYS_FADVISE,                /* Advise how a file will be accessed. */
+    SYS_MADVISE,                /* Advise how memory will be accessed. */
+    SYS_SYSPROF,                /* Read the system call profile. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2,                   /* Duplicate a file descriptor. */
+    SYS_SHM_OPEN,               /* Open a shared memory segment. */
+    SYS_SHM_MAP                 /* Map a shared memory segment. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,26 @@
+#ifndef __LIB_SYSENTER_H
+#define __LIB_SYSENTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Returns true if the CPU supports the sysenter and sysexit
+   instructions.  Early Pentium Pros set the SEP feature flag without
+   supporting them.  See [IA32-v2a] "CPUID" and [IA32-v2b]
+   "SYSENTER". */
+static inline bool
+sysenter_supported (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  if (!(edx & (1 << 11)))
+    return false;
+
+  uint32_t family = (eax >> 8) & 0xf;
+  uint32_t model = (eax >> 4) & 0xf;
+  uint32_t stepping = eax & 0xf;
+  return !(family == 6 && model < 3 && stepping < 3);
+}
+
+#endif /* lib/sysenter.h */
@@ -25,13 +25,65 @@ hprintf (int handle, const char *format, ...)
   return retval;
 }
 
+/* Size of the stdout buffer. */
+#define STDOUT_BUF_SIZE 1024
+
+/* Output to STDOUT_FILENO waits here until it is flushed: when the
+   buffer fills, at a new-line in line-buffered mode, before reading
+   the console, and before the process exits or runs or waits for
+   another. */
+static char stdout_buf[STDOUT_BUF_SIZE];
+static size_t stdout_cnt;               /* Bytes in stdout_buf. */
+static int stdout_mode = _IOLBF;        /* Buffering mode. */
+
+/* Writes C to the stdout buffer, flushing it as its mode requires. */
+static void
+stdout_putc (char c) 
+{
+  stdout_buf[stdout_cnt++] = c;
+  if (stdout_cnt >= sizeof stdout_buf
+      || stdout_mode == _IONBF
+      || (stdout_mode == _IOLBF && c == '\n'))
+    fflush (STDOUT_FILENO);
+}
+
+/* Sets the buffering mode of HANDLE to MODE, one of _IOFBF (fully
+   buffered), _IOLBF (line buffered) or _IONBF (unbuffered), after
+   flushing it.  Only STDOUT_FILENO is buffered, so this returns -1
+   for any other HANDLE or an unknown MODE, 0 on success. */
+int
+setvbuf (int handle, int mode) 
+{
+  if (handle != STDOUT_FILENO
+      || (mode != _IOFBF && mode != _IOLBF && mode != _IONBF))
+    return -1;
+  fflush (handle);
+  stdout_mode = mode;
+  return 0;
+}
+
+/* Writes out the data buffered for HANDLE.  Returns 0 if successful,
+   -1 if the write failed. */
+int
+fflush (int handle) 
+{
+  if (handle != STDOUT_FILENO || stdout_cnt == 0)
+    return 0;
+
+  /* Empty the buffer first, since write() flushes it too */
+  size_t cnt = stdout_cnt;
+  stdout_cnt = 0;
+  return write (STDOUT_FILENO, stdout_buf, cnt) == (int) cnt ? 0 : -1;
+}
+
 /* Writes string S to the console, followed by a new-line
    character. */
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
+  while (*s != '\0')
+    stdout_putc (*s++);
+  stdout_putc ('\n');
 
   return 0;
 }
@@ -40,11 +92,10 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  stdout_putc (c);
   return c;
 }
-
+
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux 
   {
@@ -55,6 +106,7 @@ struct vhprintf_aux
   };
 
 static void add_char (char, void *);
+static void add_stdout_char (char, void *);
 static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
@@ -64,6 +116,14 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
+
+  if (handle == STDOUT_FILENO)
+    {
+      int char_cnt = 0;
+      __vprintf (format, args, add_stdout_char, &char_cnt);
+      return char_cnt;
+    }
+
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
@@ -84,6 +144,15 @@ add_char (char c, void *aux_)
   aux->char_cnt++;
 }
 
+/* Adds C to the stdout buffer and counts it in the int that
+   CHAR_CNT points to. */
+static void
+add_stdout_char (char c, void *char_cnt) 
+{
+  stdout_putc (c);
+  (*(int *) char_cnt)++;
+}
+
 /* Flushes the buffer in AUX. */
 static void
 flush (struct vhprintf_aux *aux)
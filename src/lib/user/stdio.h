@@ -4,4 +4,12 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0        /* Fully buffered. */
+#define _IOLBF 1        /* Line buffered, the default for stdout. */
+#define _IONBF 2        /* Unbuffered. */
+
+int setvbuf (int handle, int mode);
+int fflush (int handle);
+
 #endif /* lib/user/stdio.h */
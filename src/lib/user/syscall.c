@@ -1,31 +1,48 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
+/* Set by _start() if the CPU supports sysenter. */
+bool syscall_sysenter;
+
+/* Enters the kernel for a system call whose number and arguments
+   have been pushed.  Uses sysenter if syscall_sysenter is set, which
+   returns to label 2 with the stack pointer passed in %ecx, or else
+   `int $0x30'. */
+#define SYSCALL_ENTER                                           \
+        "cmpb $0, %[sysenter]; je 1f; "                         \
+        "movl %%esp, %%ecx; movl $2f, %%edx; sysenter; "        \
+        "1: int $0x30; 2: "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_ENTER                  \
+             "addl $4, %%esp"                                   \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : [number] "i" (NUMBER),                         \
+                 [sysenter] "m" (syscall_sysenter)              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg0]; pushl %[number]; " SYSCALL_ENTER   \
+             "addl $8, %%esp"                                   \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [sysenter] "m" (syscall_sysenter),             \
+                 [arg0] "g" (ARG0)                              \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +52,14 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_ENTER                  \
+             "addl $12, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
+                 [sysenter] "m" (syscall_sysenter),             \
                  [arg0] "g" (ARG0),                             \
                  [arg1] "g" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -51,19 +70,42 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_ENTER                  \
+             "addl $16, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
+                 [sysenter] "m" (syscall_sysenter),             \
                  [arg0] "g" (ARG0),                             \
                  [arg1] "g" (ARG1),                             \
                  [arg2] "g" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; " SYSCALL_ENTER   \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [sysenter] "m" (syscall_sysenter),             \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 void
 halt (void) 
 {
+  fflush (STDOUT_FILENO);
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +113,7 @@ halt (void)
 void
 exit (int status)
 {
+  fflush (STDOUT_FILENO);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -78,12 +121,14 @@ exit (int status)
 pid_t
 exec (const char *file)
 {
+  fflush (STDOUT_FILENO);
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
 int
 wait (pid_t pid)
 {
+  fflush (STDOUT_FILENO);
   return syscall1 (SYS_WAIT, pid);
 }
 
@@ -114,12 +159,18 @@ filesize (int fd)
 int
 read (int fd, void *buffer, unsigned size)
 {
+  /* Show any prompt that is still buffered before waiting for input */
+  if (fd == STDIN_FILENO)
+    fflush (STDOUT_FILENO);
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
 int
 write (int fd, const void *buffer, unsigned size)
 {
+  /* Keep output in order with what is buffered for stdout */
+  if (fd == STDOUT_FILENO)
+    fflush (STDOUT_FILENO);
   return syscall3 (SYS_WRITE, fd, buffer, size);
 }
 
@@ -138,9 +189,86 @@ tell (int fd)
 void
 close (int fd)
 {
+  if (fd == STDOUT_FILENO)
+    fflush (STDOUT_FILENO);
   syscall1 (SYS_CLOSE, fd);
 }
 
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  /* Show any prompt that is still buffered before waiting for input */
+  if (fd == STDIN_FILENO)
+    fflush (STDOUT_FILENO);
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  /* Keep output in order with what is buffered for stdout */
+  if (fd == STDOUT_FILENO)
+    fflush (STDOUT_FILENO);
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool
+aio_setup (struct aio_ring *ring)
+{
+  return syscall1 (SYS_AIO_SETUP, ring);
+}
+
+int
+aio_submit (unsigned to_submit, unsigned min_complete)
+{
+  return syscall2 (SYS_AIO_SUBMIT, to_submit, min_complete);
+}
+
+bool
+fadvise (int fd, unsigned offset, unsigned length, int advice)
+{
+  return syscall4 (SYS_FADVISE, fd, offset, length, advice);
+}
+
+bool
+sysprof (int number, bool all, struct syscall_stat *st)
+{
+  return syscall3 (SYS_SYSPROF, number, all, st);
+}
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int oldfd, int newfd)
+{
+  /* Output buffered for stdout belongs to what it referred to before */
+  if (newfd == STDOUT_FILENO)
+    fflush (STDOUT_FILENO);
+  return syscall2 (SYS_DUP2, oldfd, newfd);
+}
+
 mapid_t
 mmap (int fd, void *addr)
 {
@@ -153,6 +281,24 @@ munmap (mapid_t mapid)
   syscall1 (SYS_MUNMAP, mapid);
 }
 
+int
+shm_open (const char *name, unsigned size)
+{
+  return syscall2 (SYS_SHM_OPEN, name, size);
+}
+
+mapid_t
+shm_map (int fd, void *addr)
+{
+  return syscall2 (SYS_SHM_MAP, fd, addr);
+}
+
+bool
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
 bool
 chdir (const char *dir)
 {
@@ -171,6 +317,12 @@ readdir (int fd, char name[READDIR_MAX_LEN + 1])
   return syscall2 (SYS_READDIR, fd, name);
 }
 
+int
+getdents (int fd, struct dirent *entries, unsigned count) 
+{
+  return syscall3 (SYS_GETDENTS, fd, entries, count);
+}
+
 bool
 isdir (int fd) 
 {
@@ -182,3 +334,15 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+stat (const char *file, struct stat *st) 
+{
+  return syscall2 (SYS_STAT, file, st);
+}
+
+bool
+fstat (int fd, struct stat *st) 
+{
+  return syscall2 (SYS_FSTAT, fd, st);
+}
@@ -2,6 +2,8 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -15,10 +17,102 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Directory entry filled in by getdents(). */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Is it a directory? */
+    char name[READDIR_MAX_LEN + 1];     /* Null-terminated file name. */
+  };
+
+/* File information filled in by stat() and fstat(). */
+struct stat
+  {
+    int size;                           /* Size in bytes. */
+    int inumber;                        /* Inode number. */
+    int nlink;                          /* Number of links. */
+    bool is_dir;                        /* Is it a directory? */
+  };
+
+/* Largest number of buffers passed to readv() or writev(). */
+#define IOV_MAX 32
+
+/* Buffer for readv() and writev(). */
+struct iovec
+  {
+    void *iov_base;                     /* Start of buffer. */
+    size_t iov_len;                     /* Size in bytes. */
+  };
+
+/* System call profile returned by sysprof(), in time-stamp counter
+   cycles. */
+struct syscall_stat
+  {
+    uint64_t count;                     /* Number of calls. */
+    uint64_t cycles;                    /* Cycles spent in the handler. */
+    uint64_t blocked;                   /* Part of CYCLES spent blocked. */
+  };
+
+/* How a file or mapping is going to be accessed, for fadvise() and
+   madvise(). */
+enum advice
+  {
+    ADV_NORMAL,                         /* No particular pattern. */
+    ADV_SEQUENTIAL,                     /* Read in increasing order. */
+    ADV_RANDOM,                         /* Read in no useful order. */
+    ADV_WILLNEED,                       /* Will be read soon. */
+    ADV_DONTNEED                        /* Will not be read soon. */
+  };
+
+/* Number of entries in each queue of an aio_ring. */
+#define AIO_RING_ENTRIES 32
+
+/* Operations an aio_sqe may request. */
+enum aio_opcode
+  {
+    AIO_READ,                           /* Read from a file. */
+    AIO_WRITE,                          /* Write to a file. */
+    AIO_FSYNC                           /* Write dirty blocks to disk. */
+  };
+
+/* Submission queue entry. */
+struct aio_sqe
+  {
+    int opcode;                         /* An enum aio_opcode. */
+    int fd;                             /* File to operate on. */
+    void *buf;                          /* Start of buffer. */
+    unsigned size;                      /* Size in bytes. */
+    unsigned offset;                    /* File offset to start at. */
+    unsigned user_data;                 /* Copied to the completion. */
+  };
+
+/* Completion queue entry. */
+struct aio_cqe
+  {
+    unsigned user_data;                 /* From the submission. */
+    int result;                         /* Bytes transferred, or -1. */
+  };
+
+/* Queues shared with the kernel by aio_setup(), which must be
+   page-aligned. Fill sq[sq_tail % AIO_RING_ENTRIES] and advance
+   sq_tail to submit; reap cq[cq_head % AIO_RING_ENTRIES] while cq_head
+   differs from cq_tail, then advance cq_head. */
+struct aio_ring
+  {
+    unsigned sq_head, sq_tail;          /* Submission queue indices. */
+    unsigned cq_head, cq_tail;          /* Completion queue indices. */
+    struct aio_sqe sq[AIO_RING_ENTRIES];
+    struct aio_cqe cq[AIO_RING_ENTRIES];
+  };
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
 
+/* True if system calls enter the kernel with sysenter rather than
+   `int $0x30'.  Set at startup if the CPU supports sysenter; may be
+   cleared to use `int $0x30'. */
+extern bool syscall_sysenter;
+
 /* Projects 2 and later. */
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
@@ -33,16 +127,33 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool aio_setup (struct aio_ring *);
+int aio_submit (unsigned to_submit, unsigned min_complete);
+bool fadvise (int fd, unsigned offset, unsigned length, int advice);
+bool sysprof (int number, bool all, struct syscall_stat *);
+bool pipe (int fds[2]);
+int dup2 (int oldfd, int newfd);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+int shm_open (const char *name, unsigned size);
+mapid_t shm_map (int fd, void *addr);
+bool madvise (void *addr, unsigned length, int advice);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
+int getdents (int fd, struct dirent *, unsigned count);
 bool isdir (int fd);
 int inumber (int fd);
+bool stat (const char *file, struct stat *);
+bool fstat (int fd, struct stat *);
 
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($tree);
+$tree->{'small'}{"f$_"} = [''] foreach 0...2;
+$tree->{'large'}{"f$_"} = [''] foreach 0...59;
+$tree->{'large'}{'sub'} = {};
+check_archive ($tree);
+pass;
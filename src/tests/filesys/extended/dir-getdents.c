@@ -0,0 +1,125 @@
+/* Lists a small directory and one large enough to be converted to a
+   hashed index with getdents(), a batch of entries at a time, and
+   checks the name, type and inode number of every entry.  Also checks
+   that getdents() returns 0 at the end of a directory and -1 for an
+   ordinary file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BATCH 16
+#define SMALL_CNT 3
+#define LARGE_CNT 60
+
+static struct dirent entries[BATCH];
+
+/* Returns the inode number of the file or directory at PATH. */
+static int
+path_inumber (const char *path)
+{
+  int fd, result;
+
+  fd = open (path);
+  if (fd < 2)
+    fail ("open \"%s\" failed", path);
+  result = inumber (fd);
+  close (fd);
+  return result;
+}
+
+/* Creates directory DIR holding files f0 through f<CNT - 1>, and
+   subdirectory "sub" if WITH_SUB. */
+static void
+make_dir (const char *dir, int cnt, bool with_sub)
+{
+  char path[64];
+  int i;
+
+  CHECK (mkdir (dir), "mkdir \"%s\"", dir);
+  msg ("creating %d files in \"%s\"", cnt, dir);
+  quiet = true;
+  for (i = 0; i < cnt; i++)
+    {
+      snprintf (path, sizeof path, "%s/f%d", dir, i);
+      CHECK (create (path, 0), "create \"%s\"", path);
+    }
+  quiet = false;
+  if (with_sub)
+    {
+      snprintf (path, sizeof path, "%s/sub", dir);
+      CHECK (mkdir (path), "mkdir \"%s\"", path);
+    }
+}
+
+/* Reads DIR with getdents() and checks that it lists exactly what
+   make_dir (DIR, CNT, WITH_SUB) created. */
+static void
+check_dir (const char *dir, int cnt, bool with_sub)
+{
+  bool seen[LARGE_CNT + 1];
+  char path[64];
+  int fd, n, i;
+  int calls = 0, total = 0;
+
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open (dir)) > 1, "open \"%s\"", dir);
+  while ((n = getdents (fd, entries, BATCH)) > 0)
+    {
+      calls++;
+      for (i = 0; i < n; i++)
+        {
+          struct dirent *e = &entries[i];
+          int idx;
+          bool is_dir;
+
+          if (with_sub && !strcmp (e->name, "sub"))
+            {
+              idx = cnt;
+              is_dir = true;
+            }
+          else if (e->name[0] == 'f'
+                   && (idx = atoi (e->name + 1)) >= 0 && idx < cnt)
+            is_dir = false;
+          else
+            fail ("unexpected entry \"%s\" in \"%s\"", e->name, dir);
+
+          if (seen[idx])
+            fail ("\"%s\" listed twice in \"%s\"", e->name, dir);
+          seen[idx] = true;
+          if (e->is_dir != is_dir)
+            fail ("\"%s\" in \"%s\" has the wrong type", e->name, dir);
+          snprintf (path, sizeof path, "%s/%s", dir, e->name);
+          if (e->inumber != path_inumber (path))
+            fail ("\"%s\" has the wrong inode number", path);
+          total++;
+        }
+    }
+  if (n < 0)
+    fail ("getdents \"%s\" returned %d", dir, n);
+  if (total != cnt + with_sub)
+    fail ("\"%s\" listed %d entries, not %d", dir, total, cnt + with_sub);
+  msg ("read %d entries of \"%s\" in %d calls", total, dir, calls);
+  CHECK (getdents (fd, entries, BATCH) == 0,
+         "getdents at end of \"%s\" returns 0", dir);
+  msg ("close \"%s\"", dir);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  int fd;
+
+  make_dir ("small", SMALL_CNT, false);
+  make_dir ("large", LARGE_CNT, true);
+  check_dir ("small", SMALL_CNT, false);
+  check_dir ("large", LARGE_CNT, true);
+
+  CHECK ((fd = open ("large/f0")) > 1, "open \"large/f0\"");
+  CHECK (getdents (fd, entries, BATCH) == -1,
+         "getdents on an ordinary file returns -1");
+}
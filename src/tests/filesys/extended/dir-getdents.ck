@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "small"
+(dir-getdents) creating 3 files in "small"
+(dir-getdents) mkdir "large"
+(dir-getdents) creating 60 files in "large"
+(dir-getdents) mkdir "large/sub"
+(dir-getdents) open "small"
+(dir-getdents) read 3 entries of "small" in 1 calls
+(dir-getdents) getdents at end of "small" returns 0
+(dir-getdents) close "small"
+(dir-getdents) open "large"
+(dir-getdents) read 61 entries of "large" in 4 calls
+(dir-getdents) getdents at end of "large" returns 0
+(dir-getdents) close "large"
+(dir-getdents) open "large/f0"
+(dir-getdents) getdents on an ordinary file returns -1
+(dir-getdents) end
+dir-getdents: exit(0)
+EOF
+pass;
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"file" => ["\0" x 1234], "dir" => {"x" => ['']}});
+pass;
@@ -0,0 +1,69 @@
+/* Checks that stat() and fstat() report the same size, inode number
+   and type as filesize(), inumber() and isdir(), for an ordinary file
+   and for a directory, and that stat() fails on a missing path. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Checks ST, returned by stat() or fstat() for NAME, against the
+   answers of the per-fd calls on FD, which has NAME open. */
+static void
+check_stat (const char *call, const char *name, int fd,
+            const struct stat *st)
+{
+  if (st->size != filesize (fd))
+    fail ("%s \"%s\" size is %d, not %d",
+          call, name, st->size, filesize (fd));
+  if (st->inumber != inumber (fd))
+    fail ("%s \"%s\" inumber is %d, not %d",
+          call, name, st->inumber, inumber (fd));
+  if (st->is_dir != isdir (fd))
+    fail ("%s \"%s\" has the wrong type", call, name);
+  if (st->nlink != 1)
+    fail ("%s \"%s\" nlink is %d, not 1", call, name, st->nlink);
+  msg ("%s \"%s\" matches", call, name);
+}
+
+/* Stats NAME, both by path and through FD. */
+static void
+stat_both (const char *name, int fd, struct stat *st)
+{
+  CHECK (stat (name, st), "stat \"%s\"", name);
+  check_stat ("stat", name, fd, st);
+  CHECK (fstat (fd, st), "fstat \"%s\"", name);
+  check_stat ("fstat", name, fd, st);
+}
+
+void
+test_main (void)
+{
+  struct stat file_st, dir_st;
+  char zero = 0;
+  int fd;
+
+  CHECK (create ("file", 0), "create \"file\"");
+  CHECK ((fd = open ("file")) > 1, "open \"file\"");
+  msg ("seek \"file\"");
+  seek (fd, 1233);
+  CHECK (write (fd, &zero, 1) == 1, "write \"file\"");
+  stat_both ("file", fd, &file_st);
+  if (file_st.size != 1234 || file_st.is_dir)
+    fail ("\"file\" should be a 1234-byte ordinary file");
+  msg ("close \"file\"");
+  close (fd);
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK (create ("dir/x", 0), "create \"dir/x\"");
+  CHECK ((fd = open ("dir")) > 1, "open \"dir\"");
+  stat_both ("dir", fd, &dir_st);
+  if (!dir_st.is_dir)
+    fail ("\"dir\" should be a directory");
+  if (dir_st.inumber == file_st.inumber)
+    fail ("\"file\" and \"dir\" have the same inumber");
+  msg ("close \"dir\"");
+  close (fd);
+
+  CHECK (!stat ("missing", &file_st), "stat \"missing\" fails");
+  CHECK (!stat ("dir/missing", &file_st), "stat \"dir/missing\" fails");
+}
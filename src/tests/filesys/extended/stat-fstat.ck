@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stat-fstat) begin
+(stat-fstat) create "file"
+(stat-fstat) open "file"
+(stat-fstat) seek "file"
+(stat-fstat) write "file"
+(stat-fstat) stat "file"
+(stat-fstat) stat "file" matches
+(stat-fstat) fstat "file"
+(stat-fstat) fstat "file" matches
+(stat-fstat) close "file"
+(stat-fstat) mkdir "dir"
+(stat-fstat) create "dir/x"
+(stat-fstat) open "dir"
+(stat-fstat) stat "dir"
+(stat-fstat) stat "dir" matches
+(stat-fstat) fstat "dir"
+(stat-fstat) fstat "dir" matches
+(stat-fstat) close "dir"
+(stat-fstat) stat "missing" fails
+(stat-fstat) stat "dir/missing" fails
+(stat-fstat) end
+stat-fstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Child process run by pipe-dup2 test.
+
+   Reads stdin until end of file and checks that it received the
+   sample text. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (void) 
+{
+  char buf[sizeof sample];
+  size_t ofs = 0;
+  int n;
+
+  msg ("begin");
+  while ((n = read (STDIN_FILENO, buf + ofs, sizeof buf - ofs)) > 0)
+    ofs += n;
+  if (ofs != sizeof sample - 1)
+    fail ("read %zu bytes from stdin", ofs);
+  compare_bytes (buf, sample, ofs, 0, "stdin");
+  msg ("end");
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+/* Copies sample.txt into a new file with two copy_file_range()
+   calls, checking that each advances both file positions, then tries
+   to copy a file onto itself. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  int in, out;
+
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (create ("copy.txt", 0), "create \"copy.txt\"");
+  CHECK ((out = open ("copy.txt")) > 1, "open \"copy.txt\"");
+  CHECK (copy_file_range (in, out, 100) == 100, "copy 100 bytes");
+  CHECK (tell (in) == 100 && tell (out) == 100,
+         "both positions are at 100");
+  CHECK (copy_file_range (in, out, 4096) == (int) size - 100,
+         "copy the rest");
+  CHECK (copy_file_range (in, out, 4096) == 0,
+         "copy at end of file returns 0");
+  CHECK (copy_file_range (out, out, 10) == -1,
+         "copy onto the same file returns -1");
+  msg ("close \"copy.txt\"");
+  close (out);
+  msg ("close \"sample.txt\"");
+  close (in);
+
+  check_file ("copy.txt", sample, size);
+}
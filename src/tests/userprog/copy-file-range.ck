@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) open "sample.txt"
+(copy-file-range) create "copy.txt"
+(copy-file-range) open "copy.txt"
+(copy-file-range) copy 100 bytes
+(copy-file-range) both positions are at 100
+(copy-file-range) copy the rest
+(copy-file-range) copy at end of file returns 0
+(copy-file-range) copy onto the same file returns -1
+(copy-file-range) close "copy.txt"
+(copy-file-range) close "sample.txt"
+(copy-file-range) open "copy.txt" for verification
+(copy-file-range) verified contents of "copy.txt"
+(copy-file-range) close "copy.txt"
+(copy-file-range) end
+copy-file-range: exit(0)
+EOF
+pass;
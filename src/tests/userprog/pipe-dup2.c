@@ -0,0 +1,26 @@
+/* Fills a pipe, moves its read end onto stdin with dup2(), and runs a
+   child that reads stdin until end of file.  The redirection is
+   inherited by the child, which must see exactly the data written. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int size = sizeof sample - 1;
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], sample, size) == size, "write \"sample.txt\" data");
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (dup2 (fds[0], STDIN_FILENO) == STDIN_FILENO,
+         "dup2 read end onto stdin");
+  msg ("close read end");
+  close (fds[0]);
+  msg ("wait(exec()) = %d", wait (exec ("child-pipe")));
+}
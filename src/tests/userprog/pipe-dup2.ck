@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-dup2) begin
+(pipe-dup2) pipe
+(pipe-dup2) write "sample.txt" data
+(pipe-dup2) close write end
+(pipe-dup2) dup2 read end onto stdin
+(pipe-dup2) close read end
+(child-pipe) begin
+(child-pipe) end
+child-pipe: exit(0)
+(pipe-dup2) wait(exec()) = 0
+(pipe-dup2) end
+pipe-dup2: exit(0)
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Reads back data written to a pipe, then checks that a read
+   returns 0 once the write end is closed and the pipe is empty. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[16];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write 5 bytes");
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 5, "read 5 bytes");
+  compare_bytes (buf, "hello", 5, 0, "pipe");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file returns 0");
+  msg ("close read end");
+  close (fds[0]);
+}
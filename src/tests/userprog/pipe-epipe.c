@@ -0,0 +1,23 @@
+/* Checks that each end of a pipe refuses the other end's operation,
+   and that writing to a pipe whose read end has been closed returns
+   -1 instead of blocking forever. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char c = 'x';
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (read (fds[1], &c, 1) == -1, "read from write end returns -1");
+  CHECK (write (fds[0], &c, 1) == -1, "write to read end returns -1");
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (write (fds[1], "hello", 5) == -1, "write with no reader returns -1");
+  msg ("close write end");
+  close (fds[1]);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-epipe) begin
+(pipe-epipe) pipe
+(pipe-epipe) read from write end returns -1
+(pipe-epipe) write to read end returns -1
+(pipe-epipe) close read end
+(pipe-epipe) write with no reader returns -1
+(pipe-epipe) close write end
+(pipe-epipe) end
+pipe-epipe: exit(0)
+EOF
+pass;
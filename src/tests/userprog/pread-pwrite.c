@@ -0,0 +1,37 @@
+/* Reads part of a file with pread() and builds a copy of it with
+   two out-of-order pwrite() calls, checking that neither call moves
+   the file position. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[32];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pread (handle, buf, sizeof buf, 10) == (int) sizeof buf,
+         "pread %zu bytes at offset 10", sizeof buf);
+  compare_bytes (buf, sample + 10, sizeof buf, 10, "sample.txt");
+  CHECK (tell (handle) == 0, "position is still 0");
+  CHECK (pread (handle, buf, sizeof buf, size) == 0,
+         "pread at end of file returns 0");
+  msg ("close \"sample.txt\"");
+  close (handle);
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (pwrite (handle, sample + 100, size - 100, 100) == (int) size - 100,
+         "pwrite the tail at offset 100");
+  CHECK (pwrite (handle, sample, 100, 0) == 100, "pwrite the head");
+  CHECK (tell (handle) == 0, "position is still 0");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, size);
+}
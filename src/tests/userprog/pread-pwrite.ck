@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) open "sample.txt"
+(pread-pwrite) pread 32 bytes at offset 10
+(pread-pwrite) position is still 0
+(pread-pwrite) pread at end of file returns 0
+(pread-pwrite) close "sample.txt"
+(pread-pwrite) create "test.txt"
+(pread-pwrite) open "test.txt"
+(pread-pwrite) pwrite the tail at offset 100
+(pread-pwrite) pwrite the head
+(pread-pwrite) position is still 0
+(pread-pwrite) close "test.txt"
+(pread-pwrite) open "test.txt" for verification
+(pread-pwrite) verified contents of "test.txt"
+(pread-pwrite) close "test.txt"
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
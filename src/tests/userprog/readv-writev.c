@@ -0,0 +1,48 @@
+/* Writes a file from three buffers with one writev() call, then reads
+   it back into two buffers with one readv() call. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char head[64];
+  char tail[sizeof sample];
+  struct iovec iov[3];
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  CHECK (writev (handle, iov, 3) == (int) size, "writev 3 buffers");
+  CHECK (tell (handle) == (unsigned) size, "position is at end of file");
+  msg ("close \"test.txt\"");
+  close (handle);
+  check_file ("test.txt", sample, size);
+
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  memset (tail, 0, sizeof tail);
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = tail;
+  iov[1].iov_len = sizeof tail;
+  CHECK (readv (handle, iov, 2) == (int) size, "readv 2 buffers");
+  compare_bytes (head, sample, sizeof head, 0, "test.txt");
+  compare_bytes (tail, sample + sizeof head, size - sizeof head,
+                 sizeof head, "test.txt");
+  CHECK (readv (handle, iov, 2) == 0, "readv at end of file returns 0");
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1,
+         "readv of too many buffers returns -1");
+  msg ("close \"test.txt\"");
+  close (handle);
+}
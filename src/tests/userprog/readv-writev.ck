@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "test.txt"
+(readv-writev) open "test.txt"
+(readv-writev) writev 3 buffers
+(readv-writev) position is at end of file
+(readv-writev) close "test.txt"
+(readv-writev) open "test.txt" for verification
+(readv-writev) verified contents of "test.txt"
+(readv-writev) close "test.txt"
+(readv-writev) open "test.txt"
+(readv-writev) readv 2 buffers
+(readv-writev) readv at end of file returns 0
+(readv-writev) readv of too many buffers returns -1
+(readv-writev) close "test.txt"
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Runs child-aio, which exits with asynchronous reads still in
+   flight, twice in a row, then checks that sample.txt is intact. */
+
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    CHECK (wait (exec ("child-aio")) == 0, "run child-aio");
+  check_file ("sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-exit) begin
+(aio-exit) run child-aio
+(child-aio) begin
+(child-aio) open "sample.txt"
+(child-aio) aio_setup
+(child-aio) submit 8 reads without waiting
+(child-aio) end
+child-aio: exit(0)
+(aio-exit) run child-aio
+(child-aio) begin
+(child-aio) open "sample.txt"
+(child-aio) aio_setup
+(child-aio) submit 8 reads without waiting
+(child-aio) end
+child-aio: exit(0)
+(aio-exit) open "sample.txt" for verification
+(aio-exit) verified contents of "sample.txt"
+(aio-exit) close "sample.txt"
+(aio-exit) end
+aio-exit: exit(0)
+EOF
+pass;
@@ -0,0 +1,90 @@
+/* Submits several asynchronous reads of sample.txt, one of them past
+   the end of the file and one with a bad fd, and checks the result
+   and user_data of each completion.  Then fills the completion queue
+   and checks that nothing more is submitted until it is reaped. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define READ_CNT 4
+
+static struct aio_ring ring __attribute__ ((aligned (4096)));
+static char buffers[READ_CNT][64];
+
+/* Queues a read of SIZE bytes at OFFSET of FD into BUF. */
+static void
+queue_read (int fd, void *buf, unsigned size, unsigned offset,
+            unsigned user_data)
+{
+  struct aio_sqe *sqe = &ring.sq[ring.sq_tail % AIO_RING_ENTRIES];
+
+  sqe->opcode = AIO_READ;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->size = size;
+  sqe->offset = offset;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+void
+test_main (void)
+{
+  static const unsigned offsets[READ_CNT - 1] = {0, 300, 760};
+  size_t size = sizeof sample - 1;
+  int results[READ_CNT];
+  bool seen[READ_CNT];
+  int handle, i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (aio_setup (&ring), "aio_setup");
+
+  for (i = 0; i < READ_CNT - 1; i++)
+    queue_read (handle, buffers[i], sizeof buffers[i], offsets[i], 100 + i);
+  queue_read (handle + 100, buffers[i], sizeof buffers[i], 0, 100 + i);
+  CHECK (aio_submit (READ_CNT, READ_CNT) == READ_CNT,
+         "submit %d reads", READ_CNT);
+
+  memset (seen, 0, sizeof seen);
+  while (ring.cq_head != ring.cq_tail)
+    {
+      struct aio_cqe *cqe = &ring.cq[ring.cq_head % AIO_RING_ENTRIES];
+      unsigned idx = cqe->user_data - 100;
+      if (idx >= READ_CNT || seen[idx])
+        fail ("unexpected completion with user_data %u", cqe->user_data);
+      seen[idx] = true;
+      results[idx] = cqe->result;
+      ring.cq_head++;
+    }
+  for (i = 0; i < READ_CNT; i++)
+    if (!seen[i])
+      fail ("no completion with user_data %d", 100 + i);
+  msg ("reaped %d completions", READ_CNT);
+
+  for (i = 0; i < READ_CNT - 1; i++)
+    {
+      int expected = size - offsets[i];
+      if (expected > (int) sizeof buffers[i])
+        expected = sizeof buffers[i];
+      if (results[i] != expected)
+        fail ("read at offset %u returned %d, not %d",
+              offsets[i], results[i], expected);
+      compare_bytes (buffers[i], sample + offsets[i], expected, offsets[i],
+                     "sample.txt");
+    }
+  msg ("reads returned the file's data");
+  CHECK (results[READ_CNT - 1] == -1, "read with bad fd returned -1");
+
+  for (i = 0; i < AIO_RING_ENTRIES; i++)
+    queue_read (handle, buffers[0], 1, 0, i);
+  CHECK (aio_submit (AIO_RING_ENTRIES, AIO_RING_ENTRIES) == AIO_RING_ENTRIES,
+         "submit %d reads", AIO_RING_ENTRIES);
+  queue_read (handle, buffers[0], 1, 0, 0);
+  CHECK (aio_submit (1, 0) == 0, "submit nothing while completions are full");
+  msg ("reap all completions");
+  ring.cq_head = ring.cq_tail;
+  CHECK (aio_submit (1, 1) == 1, "submit again after reaping");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-read) begin
+(aio-read) open "sample.txt"
+(aio-read) aio_setup
+(aio-read) submit 4 reads
+(aio-read) reaped 4 completions
+(aio-read) reads returned the file's data
+(aio-read) read with bad fd returned -1
+(aio-read) submit 32 reads
+(aio-read) submit nothing while completions are full
+(aio-read) reap all completions
+(aio-read) submit again after reaping
+(aio-read) end
+aio-read: exit(0)
+EOF
+pass;
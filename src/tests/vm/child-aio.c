@@ -0,0 +1,35 @@
+/* Child process for aio-exit test.
+   Submits asynchronous reads of sample.txt and exits without waiting
+   for them, so that the kernel must finish or drop them and release
+   their pinned pages during exit. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define READ_CNT 8
+
+static struct aio_ring ring __attribute__ ((aligned (4096)));
+static char buffers[READ_CNT][4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  int handle, i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (aio_setup (&ring), "aio_setup");
+  for (i = 0; i < READ_CNT; i++)
+    {
+      struct aio_sqe *sqe = &ring.sq[ring.sq_tail % AIO_RING_ENTRIES];
+      sqe->opcode = AIO_READ;
+      sqe->fd = handle;
+      sqe->buf = buffers[i];
+      sqe->size = sizeof buffers[i];
+      sqe->offset = 0;
+      sqe->user_data = i;
+      ring.sq_tail++;
+    }
+  CHECK (aio_submit (READ_CNT, 0) == READ_CNT,
+         "submit %d reads without waiting", READ_CNT);
+}
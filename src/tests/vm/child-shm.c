@@ -0,0 +1,24 @@
+/* Child process for shm-share test.
+   Maps the parent's shared memory segment at a different address,
+   checks the data the parent wrote to its first page, and copies it
+   to the second page for the parent to find. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x20000000;
+  int handle;
+
+  CHECK ((handle = shm_open ("shm-share", 8192)) > 1,
+         "shm_open \"shm-share\"");
+  CHECK (shm_map (handle, actual) != MAP_FAILED, "shm_map \"shm-share\"");
+  CHECK (!memcmp (actual, sample, strlen (sample)),
+         "first page has parent's data");
+  memcpy (actual + 4096, actual, strlen (sample));
+}
@@ -0,0 +1,21 @@
+/* Verifies that shared memory cannot be mapped at or across the
+   boundary of kernel virtual memory. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+
+  CHECK ((handle = shm_open ("shm-bad-addr", 8192)) > 1,
+         "shm_open \"shm-bad-addr\"");
+  CHECK (shm_map (handle, (void *) 0xc0000000) == MAP_FAILED,
+         "try to shm_map at PHYS_BASE");
+  CHECK (shm_map (handle, (void *) 0xfffff000) == MAP_FAILED,
+         "try to shm_map at the last kernel page");
+  CHECK (shm_map (handle, (void *) 0xbffff000) == MAP_FAILED,
+         "try to shm_map two pages across PHYS_BASE");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-bad-addr) begin
+(shm-bad-addr) shm_open "shm-bad-addr"
+(shm-bad-addr) try to shm_map at PHYS_BASE
+(shm-bad-addr) try to shm_map at the last kernel page
+(shm-bad-addr) try to shm_map two pages across PHYS_BASE
+(shm-bad-addr) end
+shm-bad-addr: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Maps a two-page shared memory segment, writes to its first page,
+   and runs child-shm, which maps the same segment at another address,
+   checks the first page and writes to the second.  Both processes
+   must see each other's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+
+  CHECK ((handle = shm_open ("shm-share", 8192)) > 1,
+         "shm_open \"shm-share\"");
+  CHECK (shm_map (handle, actual) != MAP_FAILED, "shm_map \"shm-share\"");
+  memcpy (actual, sample, strlen (sample));
+
+  CHECK (wait (exec ("child-shm")) == 0, "wait for child-shm");
+
+  CHECK (!memcmp (actual, sample, strlen (sample)),
+         "first page still has parent's data");
+  CHECK (!memcmp (actual + 4096, sample, strlen (sample)),
+         "second page has child's data");
+  msg ("close \"shm-share\"");
+  close (handle);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-share) begin
+(shm-share) shm_open "shm-share"
+(shm-share) shm_map "shm-share"
+(shm-share) wait for child-shm
+(child-shm) begin
+(child-shm) shm_open "shm-share"
+(child-shm) shm_map "shm-share"
+(child-shm) first page has parent's data
+(child-shm) end
+child-shm: exit(0)
+(shm-share) first page still has parent's data
+(shm-share) second page has child's data
+(shm-share) close "shm-share"
+(shm-share) end
+shm-share: exit(0)
+EOF
+pass;
@@ -25,6 +25,7 @@
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/aio.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
@@ -34,6 +35,7 @@
 #endif
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/shm.h"
 #include "vm/swap.h"
 #endif
 #ifdef FILESYS
@@ -51,6 +53,9 @@ uint32_t *init_page_dir;
 /* -f: Format the file system? */
 static bool format_filesys;
 
+/* -extents: Format with extent-based inodes? */
+static bool format_extents;
+
 /* -filesys, -scratch, -swap: Names of block devices to use,
    overriding the defaults. */
 static const char *filesys_bdev_name;
@@ -131,13 +136,19 @@ main (void)
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
-  filesys_init (format_filesys);
+  filesys_init (format_filesys, format_extents);
 #endif
 
 #ifdef VM
   page_init_thread (thread_current ());
   swap_init ();
   frame_init ();
+  shm_init ();
+#endif
+
+#ifdef USERPROG
+  /* Start the asynchronous I/O workers. */
+  aio_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -256,6 +267,8 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-extents"))
+        format_extents = true;
       else if (!strcmp (name, "-filesys"))
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
@@ -272,6 +285,8 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-sp"))
+        syscall_profile = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -384,6 +399,7 @@ usage (void)
           "  -r                 Reboot after actions.\n"
 #ifdef FILESYS
           "  -f                 Format file system device during startup.\n"
+          "  -extents           Use extent-based inodes when formatting.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
@@ -394,6 +410,7 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -sp                Profile system calls.\n"
 #endif
           );
   shutdown_power_off ();
@@ -15,7 +15,9 @@
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #ifdef USERPROG
+#include "threads/tsc.h"
 #include "userprog/process.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef VM
 #include "vm/page.h"
@@ -424,6 +426,15 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
+
+#ifdef USERPROG
+  /* Charge the time since T blocked to its system call profile */
+  if (t->blocked_since != 0)
+    {
+      t->blocked_cycles += rdtsc () - t->blocked_since;
+      t->blocked_since = 0;
+    }
+#endif
   
   if (!thread_mlfqs) 
   {
@@ -889,6 +900,12 @@ thread_schedule_tail (struct thread *prev)
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
+
+  /* Start timing PREV if it blocked, for system call profiling.  A
+     preempted thread stays runnable, so its wait is not counted.
+     thread_unblock() stops the clock. */
+  if (syscall_profile && prev != NULL && prev->status == THREAD_BLOCKED)
+    prev->blocked_since = rdtsc ();
 #endif
 
   /* If the thread we switched from is dying, destroy its struct
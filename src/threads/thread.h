@@ -117,9 +117,17 @@ struct thread
   int exit_code;                       /* Exit code */
 
   /* File system information */
-  struct list fd_list;       /* List of file descriptors open in this
-                                process */
-  int next_fd;
+  struct process_fd **fds;   /* Open files, indexed by fd - PFD_OFFSET */
+  struct bitmap *fd_map;     /* Marks the slots of fds in use */
+  struct process_fd *stdio[PFD_OFFSET]; /* Redirected fds 0 and 1, or
+                                           NULL for the console */
+  struct aio_context *aio;   /* Asynchronous I/O ring, or NULL */
+
+  /* System call profiling, with -sp */
+  struct syscall_stat *syscall_stats; /* Per system call, or NULL */
+  uint64_t blocked_cycles;   /* Cycles spent blocked */
+  uint64_t blocked_since;    /* Time-stamp counter when last blocked,
+                                or 0 if not blocked */
 
   /* The file that spawned this process -- this must be kept open
      until the end of the execution of the thread */
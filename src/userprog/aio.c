@@ -0,0 +1,338 @@
+#include "userprog/aio.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/buffercache.h"
+#include "filesys/file.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Number of kernel threads executing requests */
+#define AIO_WORKERS 4
+
+/* Largest transfer done by one request.  Its pages stay pinned until
+   the request is reaped, so this bounds the frames a process can pin
+   to AIO_RING_ENTRIES requests of this size. */
+#define AIO_MAX_SIZE (4 * PGSIZE)
+#define AIO_MAX_PAGES (AIO_MAX_SIZE / PGSIZE + 1)
+
+/* A process's asynchronous I/O state */
+struct aio_context
+{
+  struct aio_ring *ring;        /* Kernel address of the shared ring */
+  struct aio_ring *ring_uaddr;  /* User address of the ring, pinned */
+  struct lock lock;             /* Protects the fields below and cq */
+  struct condition completed;   /* Signaled when a completion is posted */
+  unsigned inflight;            /* Requests submitted but not completed */
+  struct list done;             /* Completed requests still pinning pages */
+};
+
+/* A request taken off the submission queue */
+struct aio_request
+{
+  struct list_elem elem;        /* In aio_queue, then the context's done */
+  struct aio_context *ctx;      /* Owning process's context */
+  struct aio_sqe sqe;           /* Copy of the submission */
+  struct file *file;            /* Private handle, closed on completion */
+  bool pinned;                  /* Whether sqe.buf is pinned */
+  uint8_t *kpages[AIO_MAX_PAGES]; /* Kernel addresses of sqe.buf's pages */
+};
+
+static struct list aio_queue;           /* Requests waiting for a worker */
+static struct lock aio_queue_lock;      /* Protects aio_queue */
+static struct condition aio_queue_data; /* Signaled on new requests */
+
+static void aio_worker (void *aux);
+
+/* Starts the worker threads. */
+void
+aio_init (void)
+{
+  int i;
+
+  list_init (&aio_queue);
+  lock_init (&aio_queue_lock);
+  cond_init (&aio_queue_data);
+
+  for (i = 0; i < AIO_WORKERS; i++)
+    if (thread_create ("aio_worker", PRI_DEFAULT, thread_get_cwd (),
+                       aio_worker, NULL) == TID_ERROR)
+      PANIC ("Could not start the aio workers");
+}
+
+/* Makes the page-aligned RING, which the caller has verified to be
+   writable user memory, the current process's shared ring.  Returns
+   false if the process already has one or memory is exhausted. */
+bool
+aio_setup (struct aio_ring *ring)
+{
+  struct thread *t = thread_current ();
+
+  if (t->aio != NULL || pg_ofs (ring) != 0)
+    return false;
+
+  struct aio_context *ctx = malloc (sizeof *ctx);
+  if (ctx == NULL)
+    return false;
+  if (!page_pin_range (ring, sizeof *ring, true))
+  {
+    free (ctx);
+    return false;
+  }
+
+  ctx->ring_uaddr = ring;
+  ctx->ring = pagedir_get_page (t->pagedir, ring);
+  lock_init (&ctx->lock);
+  cond_init (&ctx->completed);
+  ctx->inflight = 0;
+  list_init (&ctx->done);
+  memset (ctx->ring, 0, sizeof *ctx->ring);
+  t->aio = ctx;
+  return true;
+}
+
+/* Posts a completion with RESULT for SQE.  CTX's lock must be
+   held. */
+static void
+aio_complete (struct aio_context *ctx, const struct aio_sqe *sqe, int result)
+{
+  struct aio_ring *ring = ctx->ring;
+
+  ASSERT (lock_held_by_current_thread (&ctx->lock));
+
+  struct aio_cqe *cqe = &ring->cq[ring->cq_tail % AIO_RING_ENTRIES];
+  cqe->user_data = sqe->user_data;
+  cqe->result = result;
+  barrier ();
+  ring->cq_tail++;
+  cond_broadcast (&ctx->completed, &ctx->lock);
+}
+
+/* Releases the pages and memory of CTX's completed requests.  Must
+   run in the owning process, whose page table the pins are in. */
+static void
+aio_reap (struct aio_context *ctx)
+{
+  struct list done;
+
+  list_init (&done);
+  lock_acquire (&ctx->lock);
+  while (!list_empty (&ctx->done))
+    list_push_back (&done, list_pop_front (&ctx->done));
+  lock_release (&ctx->lock);
+
+  while (!list_empty (&done))
+  {
+    struct aio_request *req = list_entry (list_pop_front (&done),
+                                          struct aio_request, elem);
+    if (req->pinned)
+      page_unpin_range (req->sqe.buf, req->sqe.size);
+    free (req);
+  }
+}
+
+/* Checks SQE and prepares REQ to run it, pinning its buffer.  Returns
+   0 on success or the result to complete SQE with at once. */
+static int
+aio_prepare (struct aio_request *req)
+{
+  struct aio_sqe *sqe = &req->sqe;
+  struct thread *t = thread_current ();
+
+  req->file = NULL;
+  req->pinned = false;
+  if (sqe->opcode == AIO_FSYNC)
+    return 0;
+  if (sqe->opcode != AIO_READ && sqe->opcode != AIO_WRITE)
+    return -1;
+
+  struct process_fd *pfd = process_get_file (t, sqe->fd);
+  if (pfd == NULL || file_is_directory (pfd->file) || (int) sqe->offset < 0)
+    return -1;
+  if (sqe->size > AIO_MAX_SIZE)
+    sqe->size = AIO_MAX_SIZE;
+  if (sqe->size == 0)
+    return 0;
+
+  /* Workers run in their own address space, so they reach the buffer
+     through the kernel addresses of its pinned frames.  Writes through
+     those do not set the user page's dirty bit, so reads set it here
+     for eviction to see */
+  uint8_t *buf = sqe->buf;
+  if ((void *) buf >= PHYS_BASE || buf + sqe->size > (uint8_t *) PHYS_BASE
+      || !page_pin_range (buf, sqe->size, sqe->opcode == AIO_READ))
+    return -1;
+  req->pinned = true;
+
+  uint8_t *upage = pg_round_down (buf);
+  int i;
+  for (i = 0; upage < buf + sqe->size; i++, upage += PGSIZE)
+  {
+    req->kpages[i] = pagedir_get_page (t->pagedir, upage);
+    if (sqe->opcode == AIO_READ)
+      pagedir_set_dirty (t->pagedir, upage, true);
+  }
+
+  req->file = file_reopen (pfd->file);
+  if (req->file == NULL)
+    return -1;
+  return 0;
+}
+
+/**
+ * Takes up to to_submit requests off the current process's submission
+ * queue and hands them to the workers, then waits until at least
+ * min_complete completions are waiting to be reaped or nothing is left
+ * in flight.  Submission stops early when the completion queue could
+ * not hold the result of another request.  Returns the number of
+ * requests submitted, or -1 if the process has no ring.
+ */
+int
+aio_submit (unsigned to_submit, unsigned min_complete)
+{
+  struct aio_context *ctx = thread_current ()->aio;
+  unsigned submitted = 0;
+
+  if (ctx == NULL)
+    return -1;
+  aio_reap (ctx);
+
+  struct aio_ring *ring = ctx->ring;
+  while (submitted < to_submit)
+  {
+    /* Stop when the submission queue is empty or a completion could
+       overflow the completion queue */
+    unsigned sq_tail = ring->sq_tail;
+    barrier ();
+    if (ring->sq_head == sq_tail)
+      break;
+    lock_acquire (&ctx->lock);
+    bool room = ctx->inflight + (ring->cq_tail - ring->cq_head)
+                < AIO_RING_ENTRIES;
+    lock_release (&ctx->lock);
+    if (!room)
+      break;
+
+    struct aio_request *req = malloc (sizeof *req);
+    if (req == NULL)
+      break;
+    req->ctx = ctx;
+    req->sqe = ring->sq[ring->sq_head % AIO_RING_ENTRIES];
+    ring->sq_head++;
+    submitted++;
+
+    int result = aio_prepare (req);
+    lock_acquire (&ctx->lock);
+    ctx->inflight++;
+    if (result != 0)
+    {
+      /* Complete at once; the worker path below does the same */
+      aio_complete (ctx, &req->sqe, result);
+      ctx->inflight--;
+      list_push_back (&ctx->done, &req->elem);
+      lock_release (&ctx->lock);
+      file_close (req->file);
+      continue;
+    }
+    lock_release (&ctx->lock);
+
+    lock_acquire (&aio_queue_lock);
+    list_push_back (&aio_queue, &req->elem);
+    cond_signal (&aio_queue_data, &aio_queue_lock);
+    lock_release (&aio_queue_lock);
+  }
+
+  lock_acquire (&ctx->lock);
+  while (ring->cq_tail - ring->cq_head < min_complete && ctx->inflight > 0)
+    cond_wait (&ctx->completed, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  return submitted;
+}
+
+/* Runs REQ and returns its result. */
+static int
+aio_run (struct aio_request *req)
+{
+  struct aio_sqe *sqe = &req->sqe;
+  unsigned done = 0;
+  int i;
+
+  if (sqe->opcode == AIO_FSYNC)
+  {
+    buffercache_flush (true);
+    return 0;
+  }
+
+  uint8_t *buf = sqe->buf;
+  for (i = 0; done < sqe->size; i++)
+  {
+    size_t page_left = PGSIZE - pg_ofs (buf + done);
+    size_t chunk = sqe->size - done < page_left ? sqe->size - done : page_left;
+    uint8_t *kaddr = req->kpages[i] + pg_ofs (buf + done);
+    off_t result;
+
+    if (sqe->opcode == AIO_READ)
+      result = file_read_at (req->file, kaddr, chunk, sqe->offset + done);
+    else
+      result = file_write_at (req->file, kaddr, chunk, sqe->offset + done);
+    done += result;
+    if ((size_t) result != chunk)
+      break;
+  }
+  return done;
+}
+
+/* Worker thread: runs queued requests and posts their completions. */
+static void
+aio_worker (void *aux UNUSED)
+{
+  while (true)
+  {
+    lock_acquire (&aio_queue_lock);
+    while (list_empty (&aio_queue))
+      cond_wait (&aio_queue_data, &aio_queue_lock);
+    struct aio_request *req = list_entry (list_pop_front (&aio_queue),
+                                          struct aio_request, elem);
+    lock_release (&aio_queue_lock);
+
+    int result = aio_run (req);
+    file_close (req->file);
+
+    struct aio_context *ctx = req->ctx;
+    lock_acquire (&ctx->lock);
+    aio_complete (ctx, &req->sqe, result);
+    ctx->inflight--;
+    list_push_back (&ctx->done, &req->elem);
+    lock_release (&ctx->lock);
+  }
+}
+
+/* Waits for the current process's requests to finish and releases
+   its ring. */
+void
+aio_exit (void)
+{
+  struct thread *t = thread_current ();
+  struct aio_context *ctx = t->aio;
+
+  if (ctx == NULL)
+    return;
+
+  lock_acquire (&ctx->lock);
+  while (ctx->inflight > 0)
+    cond_wait (&ctx->completed, &ctx->lock);
+  lock_release (&ctx->lock);
+
+  aio_reap (ctx);
+  page_unpin_range (ctx->ring_uaddr, sizeof *ctx->ring_uaddr);
+  t->aio = NULL;
+  free (ctx);
+}
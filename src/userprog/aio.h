@@ -0,0 +1,13 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <stdbool.h>
+
+struct aio_ring;
+
+void aio_init (void);
+bool aio_setup (struct aio_ring *ring);
+int aio_submit (unsigned to_submit, unsigned min_complete);
+void aio_exit (void);
+
+#endif /* userprog/aio.h */
@@ -0,0 +1,165 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Capacity of a pipe's ring buffer */
+#define PIPE_SIZE PGSIZE
+
+/* A pipe: one page of data shared by the fds open on its two ends */
+struct pipe
+{
+  uint8_t *buf;                 /* Ring buffer of PIPE_SIZE bytes */
+  struct lock lock;             /* Protects the fields below */
+  struct condition not_empty;   /* Signaled when data or EOF arrives */
+  struct condition not_full;    /* Signaled when space frees up */
+  size_t start;                 /* Offset of the first byte in buf */
+  size_t used;                  /* Number of bytes in buf */
+  int readers;                  /* Open read ends */
+  int writers;                  /* Open write ends */
+};
+
+/* Creates a pipe with one read end and one write end open.  Returns
+   NULL if memory is not available. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *pipe = malloc (sizeof *pipe);
+  if (pipe == NULL)
+    return NULL;
+
+  pipe->buf = palloc_get_page (0);
+  if (pipe->buf == NULL)
+  {
+    free (pipe);
+    return NULL;
+  }
+
+  lock_init (&pipe->lock);
+  cond_init (&pipe->not_empty);
+  cond_init (&pipe->not_full);
+  pipe->start = 0;
+  pipe->used = 0;
+  pipe->readers = 1;
+  pipe->writers = 1;
+  return pipe;
+}
+
+/* Opens another read end of pipe, or write end if writer. */
+void
+pipe_dup (struct pipe *pipe, bool writer)
+{
+  lock_acquire (&pipe->lock);
+  if (writer)
+    pipe->writers++;
+  else
+    pipe->readers++;
+  lock_release (&pipe->lock);
+}
+
+/* Closes a read end of pipe, or a write end if writer.  Closing the
+   last write end gives readers end of file, and closing the last read
+   end fails pending writes.  The pipe is freed once both sides are
+   closed. */
+void
+pipe_close (struct pipe *pipe, bool writer)
+{
+  lock_acquire (&pipe->lock);
+  if (writer)
+  {
+    ASSERT (pipe->writers > 0);
+    if (--pipe->writers == 0)
+      cond_broadcast (&pipe->not_empty, &pipe->lock);
+  }
+  else
+  {
+    ASSERT (pipe->readers > 0);
+    if (--pipe->readers == 0)
+      cond_broadcast (&pipe->not_full, &pipe->lock);
+  }
+  bool unused = pipe->readers == 0 && pipe->writers == 0;
+  lock_release (&pipe->lock);
+
+  if (unused)
+  {
+    palloc_free_page (pipe->buf);
+    free (pipe);
+  }
+}
+
+/* Reads up to size bytes from pipe into buffer.  If the pipe is empty
+   and block is true, waits until data arrives or every write end is
+   closed.  Returns the number of bytes read, which is 0 at end of file
+   or if the pipe is empty and block is false.  buffer must not fault,
+   since the pipe's lock is held while copying into it. */
+int
+pipe_read (struct pipe *pipe, void *buffer, size_t size, bool block)
+{
+  uint8_t *dst = buffer;
+  size_t total = 0;
+
+  lock_acquire (&pipe->lock);
+  while (block && pipe->used == 0 && pipe->writers > 0)
+    cond_wait (&pipe->not_empty, &pipe->lock);
+
+  /* Copy out in at most two pieces, around the end of buf */
+  while (total < size && pipe->used > 0)
+  {
+    size_t chunk = PIPE_SIZE - pipe->start;
+    if (chunk > pipe->used)
+      chunk = pipe->used;
+    if (chunk > size - total)
+      chunk = size - total;
+
+    memcpy (dst + total, pipe->buf + pipe->start, chunk);
+    pipe->start = (pipe->start + chunk) % PIPE_SIZE;
+    pipe->used -= chunk;
+    total += chunk;
+  }
+
+  if (total > 0)
+    cond_signal (&pipe->not_full, &pipe->lock);
+  lock_release (&pipe->lock);
+  return total;
+}
+
+/* Writes size bytes from buffer to pipe, waiting for readers to make
+   room as needed.  Returns the number of bytes written, which is less
+   than size only if every read end is closed, or -1 if they were
+   closed before anything was written.  buffer must not fault, since
+   the pipe's lock is held while copying from it. */
+int
+pipe_write (struct pipe *pipe, const void *buffer, size_t size)
+{
+  const uint8_t *src = buffer;
+  size_t total = 0;
+
+  lock_acquire (&pipe->lock);
+  while (total < size && pipe->readers > 0)
+  {
+    if (pipe->used == PIPE_SIZE)
+    {
+      cond_wait (&pipe->not_full, &pipe->lock);
+      continue;
+    }
+
+    size_t end = (pipe->start + pipe->used) % PIPE_SIZE;
+    size_t chunk = PIPE_SIZE - end;
+    if (chunk > PIPE_SIZE - pipe->used)
+      chunk = PIPE_SIZE - pipe->used;
+    if (chunk > size - total)
+      chunk = size - total;
+
+    memcpy (pipe->buf + end, src + total, chunk);
+    pipe->used += chunk;
+    total += chunk;
+    cond_signal (&pipe->not_empty, &pipe->lock);
+  }
+  lock_release (&pipe->lock);
+
+  return total == 0 && size > 0 ? -1 : (int) total;
+}
@@ -1,4 +1,5 @@
 #include "userprog/process.h"
+#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <list.h>
@@ -7,8 +8,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "devices/input.h"
+#include "userprog/aio.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/pipe.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
@@ -25,6 +28,7 @@
 #ifdef VM
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/shm.h"
 #endif
 
 static thread_func start_process NO_RETURN;
@@ -41,6 +45,8 @@ struct process_info {
 
 static bool load (struct process_info *pinfo, void (**eip) (void), void **esp);
 static void push_args(struct process_info * pinfo, void **esp);
+static bool inherit_stdio (struct thread *t);
+static bool process_kill_mmap (struct process_mmap *mmap);
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -191,13 +197,21 @@ process_create_pcb (struct thread *t)
   t->pcb = malloc (sizeof (struct process_status));
   if (t->pcb == NULL) return false;
 
+  /* Redirected console fds carry over to the new process */
+  if (!inherit_stdio (t))
+  {
+    free (t->pcb);
+    return false;
+  }
+
   /* Initialize object */
   t->pcb->tid = t->tid;
   t->pcb->t = t;
   lock_init (&t->pcb->l);
   cond_init (&t->pcb->cond);
-  list_init (&t->fd_list);
-  t->next_fd = PFD_OFFSET;
+  t->fds = NULL;
+  t->fd_map = NULL;
+  t->aio = NULL;
   t->exec_file = NULL;
 
    /* Initialize list of child processes */
@@ -219,17 +233,26 @@ process_exit (void)
   /* Print exit message */
   if (cur->user)
     printf ("%s: exit(%d)\n", cur->name, cur->exit_code);
+  syscall_profile_exit ();
 
-  /* Close files that the process holds */
-  struct list *fds = &cur->fd_list;
-  while (!list_empty (fds))
-  {
-    struct list_elem *e = list_front (fds);
-    struct process_fd * fd = list_entry (e, struct process_fd, elem);
-
-    process_mmap_file_close (fd->file);
+  /* Let pending asynchronous I/O finish while its pages are mapped */
+  aio_exit ();
 
-    syscall_close (fd->fd);
+  /* Close files and pipes that the process holds */
+  syscall_close (STDIN_FILENO);
+  syscall_close (STDOUT_FILENO);
+  if (cur->fd_map != NULL)
+  {
+    size_t i;
+    for (i = 0; i < bitmap_size (cur->fd_map); i++)
+      if (cur->fds[i] != NULL)
+      {
+        if (cur->fds[i]->file != NULL)
+          process_mmap_file_close (cur->fds[i]->file);
+        syscall_close (cur->fds[i]->fd);
+      }
+    bitmap_destroy (cur->fd_map);
+    free (cur->fds);
   }
 
   /* Interact with our pcb object */
@@ -264,6 +287,10 @@ process_exit (void)
   }
 
 #ifdef VM
+  /* Unmap shared memory, which no file descriptor keeps mapped */
+  while (!list_empty (&cur->mmap_list))
+    process_kill_mmap (list_entry (list_front (&cur->mmap_list),
+                                   struct process_mmap, elem));
 
   /* Unallocate all remaining pages in the supplemental page table */
   lock_acquire (&cur->s_page_lock);
@@ -643,53 +670,137 @@ setup_stack (void **esp)
   return success;
 }
 
+/* Initial number of slots in a process's file descriptor table. */
+#define PFD_INITIAL_CNT 16
+
+/* Highest fd that process_dup_fd() will grow the table to reach. */
+#define PFD_DUP_MAX 1023
+
 static struct process_fd*
 get_process_fd (struct thread *t, int fd) 
 {
-  if (fd < PFD_OFFSET) return NULL;
+  if (fd >= 0 && fd < PFD_OFFSET) return t->stdio[fd];
+  if (fd < PFD_OFFSET || t->fd_map == NULL) return NULL;
 
-  struct list *fd_list = &t->fd_list;
-  struct list_elem *elem = list_begin (fd_list);
-  for (; elem != list_end (fd_list); elem = list_next (elem))
-  {
-    struct process_fd *pfd = 
-      list_entry (elem, struct process_fd, elem);
+  size_t idx = fd - PFD_OFFSET;
+  if (idx >= bitmap_size (t->fd_map)) return NULL;
+
+  return t->fds[idx];
+}
 
-    if (pfd->fd == fd) return pfd;
+/* Doubles the size of T's file descriptor table, allocating it on
+   first use.  Returns false if memory is exhausted. */
+static bool
+grow_process_fds (struct thread *t)
+{
+  size_t old_cnt = t->fd_map != NULL ? bitmap_size (t->fd_map) : 0;
+  size_t new_cnt = old_cnt != 0 ? old_cnt * 2 : PFD_INITIAL_CNT;
+
+  struct bitmap *map = bitmap_create (new_cnt);
+  if (map == NULL) return false;
+  struct process_fd **fds = realloc (t->fds, new_cnt * sizeof *fds);
+  if (fds == NULL)
+  {
+    bitmap_destroy (map);
+    return false;
   }
 
-  return NULL;
+  memset (fds + old_cnt, 0, (new_cnt - old_cnt) * sizeof *fds);
+  if (t->fd_map != NULL)
+  {
+    size_t i;
+    for (i = 0; i < old_cnt; i++)
+      bitmap_set (map, i, bitmap_test (t->fd_map, i));
+    bitmap_destroy (t->fd_map);
+  }
+  t->fds = fds;
+  t->fd_map = map;
+  return true;
 }
 
-/* this function is not responsible for freeing filename but expects
-   it to be valid memory while the process fd is still in the list */
-int 
-process_add_file (struct thread *t, struct file *file, 
-                  const char* filename)
+/* Adds PFD to T's descriptor table in the lowest free slot and
+   returns its fd, or -1 if memory is exhausted. */
+static int
+add_process_fd (struct thread *t, struct process_fd *pfd)
 {
-  struct list *fd_list = &t->fd_list;
+  size_t idx = BITMAP_ERROR;
+  if (t->fd_map != NULL)
+    idx = bitmap_scan_and_flip (t->fd_map, 0, 1, false);
+  if (idx == BITMAP_ERROR)
+  {
+    idx = t->fd_map != NULL ? bitmap_size (t->fd_map) : 0;
+    if (!grow_process_fds (t))
+      return -1;
+    bitmap_mark (t->fd_map, idx);
+  }
+
+  pfd->fd = idx + PFD_OFFSET;
+  t->fds[idx] = pfd;
+  return pfd->fd;
+}
 
+/* Adds a descriptor for FILE, PIPE or SHM, whichever is not NULL, to
+   T's descriptor table and returns its fd, or -1 if memory is
+   exhausted. */
+static int
+add_new_process_fd (struct thread *t, struct file *file, struct pipe *pipe,
+                    bool pipe_writer, struct shm *shm)
+{
   struct process_fd *new_fd = malloc (sizeof (struct process_fd));
   if (new_fd == NULL) return -1;
-  new_fd->file = file;
-  new_fd->fd = t->next_fd++;
-  new_fd->filename = strdup (filename);
 
-  if (new_fd->filename == NULL) 
+  new_fd->file = file;
+  new_fd->pipe = pipe;
+  new_fd->pipe_writer = pipe_writer;
+  new_fd->shm = shm;
+  if (add_process_fd (t, new_fd) == -1)
   {
     free (new_fd);
     return -1;
   }
-
-  list_push_back (fd_list, &new_fd->elem);
   return new_fd->fd;
 }
 
+/* Adds FILE to T's descriptor table in the lowest free slot and
+   returns its fd, or -1 if memory is exhausted. */
+int 
+process_add_file (struct thread *t, struct file *file)
+{
+  return add_new_process_fd (t, file, NULL, false, NULL);
+}
+
+/* Adds the read end of PIPE, or its write end if WRITER, to T's
+   descriptor table and returns its fd, or -1 if memory is
+   exhausted. */
+int
+process_add_pipe (struct thread *t, struct pipe *pipe, bool writer)
+{
+  return add_new_process_fd (t, NULL, pipe, writer, NULL);
+}
+
+/* Adds a reference to shared memory segment SHM to T's descriptor
+   table and returns its fd, or -1 if memory is exhausted. */
+int
+process_add_shm (struct thread *t, struct shm *shm)
+{
+  return add_new_process_fd (t, NULL, NULL, false, shm);
+}
+
+/* Returns the open file fd of T, or NULL if fd is not open or is not
+   a file. */
 struct process_fd* 
 process_get_file (struct thread *t, int fd) 
 {
   struct process_fd* pfd = get_process_fd (t, fd);
-  return pfd;
+  return pfd != NULL && pfd->file != NULL ? pfd : NULL;
+}
+
+/* Returns fd of T whatever it refers to, or NULL if fd is not open.
+   Fds 0 and 1 are NULL unless they were redirected. */
+struct process_fd*
+process_get_fd (struct thread *t, int fd)
+{
+  return get_process_fd (t, fd);
 }
 
 void
@@ -698,35 +809,168 @@ process_remove_file (struct thread *t, int fd)
   struct process_fd* pfd = get_process_fd (t, fd);
 
   if (pfd == NULL) return;
-  list_remove (&pfd->elem);
-  free (pfd->filename);
+  if (fd < PFD_OFFSET)
+    t->stdio[fd] = NULL;
+  else
+  {
+    t->fds[fd - PFD_OFFSET] = NULL;
+    bitmap_reset (t->fd_map, fd - PFD_OFFSET);
+  }
+  free (pfd);
+}
+
+/* Closes what PFD refers to and frees it, for descriptors that never
+   made it into a table. */
+static void
+free_process_fd (struct process_fd *pfd)
+{
+  if (pfd->pipe != NULL)
+    pipe_close (pfd->pipe, pfd->pipe_writer);
+  else if (pfd->shm != NULL)
+    shm_close (pfd->shm);
+  else
+    file_close (pfd->file);
   free (pfd);
 }
 
+/* Returns a new descriptor for what PFD refers to.  A pipe end or
+   shared memory segment is shared; a file is reopened at the same
+   position, since struct file cannot be shared between descriptors.
+   Returns NULL if memory is exhausted. */
+static struct process_fd *
+dup_process_fd (const struct process_fd *pfd)
+{
+  struct process_fd *new_fd = malloc (sizeof (struct process_fd));
+  if (new_fd == NULL) return NULL;
+
+  *new_fd = *pfd;
+  if (pfd->pipe != NULL)
+    pipe_dup (pfd->pipe, pfd->pipe_writer);
+  else if (pfd->shm != NULL)
+    shm_dup (pfd->shm);
+  else
+  {
+    new_fd->file = file_reopen (pfd->file);
+    if (new_fd->file == NULL)
+    {
+      free (new_fd);
+      return NULL;
+    }
+    file_seek (new_fd->file, file_tell (pfd->file));
+  }
+  return new_fd;
+}
+
+/* Makes NEWFD of T refer to what OLDFD refers to, closing NEWFD first
+   if it is open.  NEWFD may be 0 or 1, redirecting the console; the
+   redirection lasts until NEWFD is closed and is inherited by
+   processes T executes.  Returns NEWFD, or -1 if OLDFD is not open,
+   NEWFD is negative or above PFD_DUP_MAX, or memory is exhausted. */
+int
+process_dup_fd (struct thread *t, int oldfd, int newfd)
+{
+  struct process_fd *old_fd = get_process_fd (t, oldfd);
+  if (old_fd == NULL || newfd < 0 || newfd > PFD_DUP_MAX) return -1;
+  if (oldfd == newfd) return newfd;
+
+  struct process_fd *new_fd = dup_process_fd (old_fd);
+  if (new_fd == NULL) return -1;
+  new_fd->fd = newfd;
+
+  if (newfd < PFD_OFFSET)
+  {
+    syscall_close (newfd);
+    t->stdio[newfd] = new_fd;
+    return newfd;
+  }
+
+  size_t idx = newfd - PFD_OFFSET;
+  while (t->fd_map == NULL || idx >= bitmap_size (t->fd_map))
+    if (!grow_process_fds (t))
+    {
+      free_process_fd (new_fd);
+      return -1;
+    }
+  syscall_close (newfd);
+  t->fds[idx] = new_fd;
+  bitmap_mark (t->fd_map, idx);
+  return newfd;
+}
+
+/* Gives T, a new thread, copies of the current thread's redirections
+   of fds 0 and 1.  Returns false if memory is exhausted. */
+static bool
+inherit_stdio (struct thread *t)
+{
+  struct thread *cur = thread_current ();
+  int fd;
+
+  for (fd = 0; fd < PFD_OFFSET; fd++)
+  {
+    t->stdio[fd] = NULL;
+    if (cur->stdio[fd] != NULL
+        && (t->stdio[fd] = dup_process_fd (cur->stdio[fd])) == NULL)
+    {
+      while (fd-- > 0)
+        if (t->stdio[fd] != NULL)
+          free_process_fd (t->stdio[fd]);
+      return false;
+    }
+  }
+  return true;
+}
+
 struct process_mmap* 
-mmap_create (const char *filename)
+mmap_create (struct file *file)
 {
-  ASSERT (filename != NULL);
+  ASSERT (file != NULL);
   struct process_mmap *mmap = malloc (sizeof (struct process_mmap));
   if (mmap == NULL)
     return NULL;
 
   /* Make a copy of the file struct. */
-  int fd = syscall_open (filename);
+  int fd = syscall_reopen (file);
   struct process_fd *pfd = process_get_file (thread_current (), fd);
-  struct file * file = pfd->file;
-  if (file == NULL) return NULL;
+  if (pfd == NULL)
+  {
+    free (mmap);
+    return NULL;
+  }
+  file = pfd->file;
 
   list_init (&mmap->entries);
   mmap->size = file_length (file);
   mmap->file = file;
+  mmap->shm = NULL;
   mmap->id = INVALID_MMAP_ID;
 
   return mmap;
 }
 
-bool mmap_add (struct process_mmap *mmap, void* uaddr, 
-                   unsigned offset)
+/* Creates an mmap of the whole of shared memory segment SHM, which
+   holds a reference to SHM until it is destroyed. */
+struct process_mmap *
+mmap_create_shm (struct shm *shm)
+{
+  ASSERT (shm != NULL);
+  struct process_mmap *mmap = malloc (sizeof (struct process_mmap));
+  if (mmap == NULL)
+    return NULL;
+
+  shm_dup (shm);
+  list_init (&mmap->entries);
+  mmap->size = shm_page_cnt (shm) * PGSIZE;
+  mmap->file = NULL;
+  mmap->shm = shm;
+  mmap->id = INVALID_MMAP_ID;
+
+  return mmap;
+}
+
+/* Returns true if nothing is mapped at page UADDR of the current
+   process. */
+static bool
+mmap_addr_free (void *uaddr)
 {
   /* Check that there is no existing mapping for the current thread
      for this address */
@@ -739,13 +983,16 @@ bool mmap_add (struct process_mmap *mmap, void* uaddr,
 
   lock_acquire (&t->s_page_lock);
   struct hash_elem *e = hash_find (&t->s_page_table, &key.elem);
-  if (e != NULL) 
-  {
-    lock_release (&t->s_page_lock);
-    return false;
-  }
   lock_release (&t->s_page_lock);
 
+  return e == NULL;
+}
+
+bool mmap_add (struct process_mmap *mmap, void* uaddr, 
+                   unsigned offset)
+{
+  if (!mmap_addr_free (uaddr)) return false;
+
   /* Check if there are zero bytes on this page */
   uint32_t zero_bytes = 0;
   uint32_t file_remain = mmap->size - offset;
@@ -771,6 +1018,27 @@ bool mmap_add (struct process_mmap *mmap, void* uaddr,
   return true;
 }
 
+/* Maps page IDX of MMAP's shared memory segment at UADDR. */
+bool
+mmap_add_shm (struct process_mmap *mmap, void *uaddr, size_t idx)
+{
+  if (!mmap_addr_free (uaddr)) return false;
+
+  struct mmap_entry *entry = malloc (sizeof (struct mmap_entry));
+  if (entry == NULL) return false;
+
+  entry->uaddr = uaddr;
+  if (!vm_add_shared_page (uaddr, shm_get_page (mmap->shm, idx)))
+  {
+    free (entry);
+    return false;
+  }
+
+  list_push_back (&mmap->entries, &entry->elem);
+
+  return true;
+}
+
 /* Frees the memmory associated with an mmap and unmaps its pages
    from memory */
 void mmap_destroy (struct process_mmap *mmap)
@@ -802,6 +1070,8 @@ void mmap_destroy (struct process_mmap *mmap)
     free (entry);
   }
 
+  if (mmap->shm != NULL)
+    shm_close (mmap->shm);
   free (mmap);
 }
 
@@ -6,15 +6,17 @@
 #include "threads/synch.h"
 #include "filesys/file.h"
 
+struct pipe;
+struct shm;
+
 #define INVALID_MMAP_ID -1
 
 struct process_fd 
 {
-  struct list_elem elem;     /* List placement in owning process */
-  struct file *file;         /* Handle to the file */
-  const char* filename;      /* This memory does not need to be freed
-                                because it is handled by the global
-                                list of file descriptors in syscall.c*/
+  struct file *file;         /* Handle to the file, or NULL for a pipe */
+  struct pipe *pipe;         /* Pipe this is an end of, or NULL */
+  bool pipe_writer;          /* Whether this is the pipe's write end */
+  struct shm *shm;           /* Shared memory segment, or NULL */
   int fd;
 };
 
@@ -33,6 +35,7 @@ struct process_mmap
   struct list_elem elem;    /* list_elem for storage in a process */
 
   struct file *file;        /* The file that is backing our pages */
+  struct shm *shm;          /* Or the shared memory segment, or NULL */
   struct list entries;      /* List of virtual pages in this mmap */  
   unsigned size;            /* Total size of the file */
   int id;                   /* mmap id for this mmap */
@@ -57,16 +60,21 @@ bool process_create_pcb (struct thread *t);
 
 /* Functions for manipulating the mapping between fd and file* for
    a given process */
-int process_add_file (struct thread *t, struct file *file, 
-  const char* filename);
+int process_add_file (struct thread *t, struct file *file);
+int process_add_pipe (struct thread *t, struct pipe *pipe, bool writer);
+int process_add_shm (struct thread *t, struct shm *shm);
 struct process_fd* process_get_file (struct thread *t, int fd);
+struct process_fd* process_get_fd (struct thread *t, int fd);
 void process_remove_file (struct thread *t, int fd);
+int process_dup_fd (struct thread *t, int oldfd, int newfd);
 
 /* Functions for manipulating mmapps for a given process */
 struct process_mmap* 
-mmap_create (const char *filename);
+mmap_create (struct file *file);
+struct process_mmap *mmap_create_shm (struct shm *shm);
 bool mmap_add (struct process_mmap *mmap, void* uaddr, 
                    unsigned offset);
+bool mmap_add_shm (struct process_mmap *mmap, void *uaddr, size_t idx);
 void mmap_destroy (struct process_mmap *mmap);
 
 int process_add_mmap (struct process_mmap *mmap);
@@ -1,66 +1,158 @@
+#include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <syscall-nr.h>
-#include <hash.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sysenter.h>
 #include "threads/malloc.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "userprog/aio.h"
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/pipe.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
+#include "userprog/tss.h"
 #include "filesys/directory.h"
+#include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
+#include "vm/page.h"
+#include "vm/shm.h"
 
-struct fd_hash
-{
-  block_sector_t inumber;
-  int count;
-  bool delete;
-  struct hash_elem elem;
-};
+static void syscall_handler (struct intr_frame *);
 
-struct hash fd_all;
-struct lock fd_all_lock;
+/* Model-specific registers that set where sysenter enters the
+   kernel.  See [IA32-v3a] 5.8.7 "Performing Fast Calls to System
+   Procedures with the SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
 
-static struct fd_hash*
-fd_hash_init (void)
+/* In userprog/sysenter.S. */
+void syscall_sysenter_entry (void);
+uint32_t syscall_sysenter (uint32_t eax, void *esp);
+
+/* Names of the system calls, by number, for the profile. */
+static const char *syscall_names[] =
+  {
+    [SYS_HALT] = "halt", [SYS_EXIT] = "exit", [SYS_EXEC] = "exec",
+    [SYS_WAIT] = "wait", [SYS_CREATE] = "create", [SYS_REMOVE] = "remove",
+    [SYS_OPEN] = "open", [SYS_FILESIZE] = "filesize", [SYS_READ] = "read",
+    [SYS_WRITE] = "write", [SYS_SEEK] = "seek", [SYS_TELL] = "tell",
+    [SYS_CLOSE] = "close", [SYS_MMAP] = "mmap", [SYS_MUNMAP] = "munmap",
+    [SYS_CHDIR] = "chdir", [SYS_MKDIR] = "mkdir",
+    [SYS_READDIR] = "readdir", [SYS_ISDIR] = "isdir",
+    [SYS_INUMBER] = "inumber", [SYS_GETDENTS] = "getdents",
+    [SYS_STAT] = "stat", [SYS_FSTAT] = "fstat", [SYS_PREAD] = "pread",
+    [SYS_PWRITE] = "pwrite", [SYS_READV] = "readv",
+    [SYS_WRITEV] = "writev", [SYS_COPY_FILE_RANGE] = "copy_file_range",
+    [SYS_AIO_SETUP] = "aio_setup", [SYS_AIO_SUBMIT] = "aio_submit",
+    [SYS_FADVISE] = "fadvise", [SYS_MADVISE] = "madvise",
+    [SYS_SYSPROF] = "sysprof", [SYS_PIPE] = "pipe", [SYS_DUP2] = "dup2",
+    [SYS_SHM_OPEN] = "shm_open", [SYS_SHM_MAP] = "shm_map",
+  };
+
+/* Number of system calls that are profiled. */
+#define SYSCALL_CNT (sizeof syscall_names / sizeof *syscall_names)
+
+bool syscall_profile;
+
+/* System-wide profile, protected by disabling interrupts, which is
+   cheaper than a lock for a few additions on every system call. */
+static struct syscall_stat syscall_stats[SYSCALL_CNT];
+
+/* Counts a call of system call NUMBER by the current process before
+   it is handled.  Sets *START and *BLOCKED for syscall_profile_end(). */
+static void
+syscall_profile_begin (uint32_t number, uint64_t *start, uint64_t *blocked)
 {
-  struct fd_hash *fd = calloc (1, sizeof (struct fd_hash));
-  return fd;
+  struct thread *t = thread_current ();
+
+  if (t->syscall_stats == NULL)
+    t->syscall_stats = calloc (SYSCALL_CNT, sizeof *t->syscall_stats);
+  if (t->syscall_stats != NULL)
+    t->syscall_stats[number].count++;
+
+  enum intr_level old_level = intr_disable ();
+  syscall_stats[number].count++;
+  intr_set_level (old_level);
+
+  *blocked = t->blocked_cycles;
+  *start = rdtsc ();
 }
 
+/* Adds the time since syscall_profile_begin() set START and
+   BLOCKED_START to the profile of system call NUMBER. */
 static void
-fd_hash_destroy (struct fd_hash *h)
+syscall_profile_end (uint32_t number, uint64_t start,
+                     uint64_t blocked_start)
 {
-  hash_delete (&fd_all, &h->elem);
-  free (h);
+  struct thread *t = thread_current ();
+  uint64_t cycles = rdtsc () - start;
+  uint64_t blocked = t->blocked_cycles - blocked_start;
+
+  if (t->syscall_stats != NULL)
+  {
+    t->syscall_stats[number].cycles += cycles;
+    t->syscall_stats[number].blocked += blocked;
+  }
+
+  enum intr_level old_level = intr_disable ();
+  syscall_stats[number].cycles += cycles;
+  syscall_stats[number].blocked += blocked;
+  intr_set_level (old_level);
 }
 
-static unsigned
-hash_hash_fd_hash (const struct hash_elem *e, void *aux UNUSED)
+/* Prints the system calls made in STATS, prefixing each line with
+   PREFIX. */
+static void
+syscall_print_profile (const char *prefix, const struct syscall_stat *stats)
 {
-  struct fd_hash *e_fd = hash_entry (e, struct fd_hash, elem);
-  unsigned hash_val = e_fd->inumber;
-  return hash_val;
+  size_t i;
+
+  for (i = 0; i < SYSCALL_CNT; i++)
+    if (stats[i].count > 0)
+      printf ("%s%s: %"PRIu64" calls, %"PRIu64" cycles, "
+              "%"PRIu64" blocked\n", prefix, syscall_names[i],
+              stats[i].count, stats[i].cycles, stats[i].blocked);
 }
 
-static bool
-hash_less_fd_hash (const struct hash_elem *a, const struct hash_elem *b,
-                   void *aux UNUSED)
+/* Prints the current process's system call profile, if any, and
+   frees it. */
+void
+syscall_profile_exit (void)
 {
-  struct fd_hash *a_fd = hash_entry (a, struct fd_hash, elem);
-  struct fd_hash *b_fd = hash_entry (b, struct fd_hash, elem);
+  struct thread *t = thread_current ();
 
-  return a_fd->inumber < b_fd->inumber;
+  if (t->syscall_stats == NULL)
+    return;
+
+  char prefix[sizeof t->name + 2];
+  snprintf (prefix, sizeof prefix, "%s: ", t->name);
+  syscall_print_profile (prefix, t->syscall_stats);
+  free (t->syscall_stats);
+  t->syscall_stats = NULL;
 }
 
-static void syscall_handler (struct intr_frame *);
+/* Prints the system-wide system call profile. */
+void
+syscall_print_stats (void)
+{
+  if (syscall_profile)
+  {
+    printf ("System calls:\n");
+    syscall_print_profile ("  ", syscall_stats);
+  }
+}
 
 /* Reads a byte at user virtual address UADDR. UADDR must be below
    PHYS_BASE.  Returns the byte value if successful, -1 if a segfault
@@ -85,17 +177,6 @@ put_user (uint8_t *udst, uint8_t byte)
   return error_code != -1;
 }
 
-/* Reads a byte at user virtual address UADDR. Returns the byte value
-   if successful, -1 if address was invalid. */
-static int
-get_byte (const uint8_t *uaddr)
-{
-  if (((void*)uaddr) < PHYS_BASE)
-    return get_user (uaddr);
-  else
-    return -1;
-}
-
 /* Writes BYTE to user address UDST. Returns true if successful, false
    if unsuccessful. */
 static bool
@@ -115,67 +196,92 @@ process_kill (void)
   thread_exit ();
 }
 
-/* Verifies that size memory at ptr is valid */
+/* Returns true if the user page UPAGE may be accessed by the kernel,
+   writing to it if WRITE is true.  A page that is already mapped is
+   checked against the page table alone; otherwise the supplemental
+   page table says whether touching it will load it.  Only a page that
+   is in neither is probed, once, so that the fault handler can grow
+   the stack into it. */
+static bool
+page_verify (const uint8_t *upage, bool write)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if ((void *)upage >= PHYS_BASE)
+    return false;
+  if (pagedir_get_page (pd, upage) != NULL)
+    return !write || pagedir_is_writable (pd, upage);
+  if (page_is_valid (upage, write))
+    return true;
+  return get_user (upage) != -1 && page_is_valid (upage, write);
+}
+
+/* Verifies that size memory at ptr is valid, writable if write is
+   true.  Kills the process otherwise. */
 static void
-memory_verify (void *ptr, size_t size)
+memory_verify_range (const void *ptr, size_t size, bool write)
 {
   if (size == 0) return;
-  /*Get the first page this data spans */
-  uint32_t start_page = (uint32_t)ptr / PGSIZE;
+  const uint8_t *start = pg_round_down (ptr);
+  const uint8_t *last = (const uint8_t *)ptr + size - 1;
+  const uint8_t *page;
 
-  /*Get the last page this data spans */
-  uint32_t end_page = (uint32_t)(ptr + size - 1) / PGSIZE;
+  if (last < (const uint8_t *)ptr)
+    process_kill ();
 
-  /* Check the first byte of each page */
-  uint32_t page;
-  for (page = start_page; page <= end_page; page++)
+  for (page = start; page <= last; page += PGSIZE)
   {
-    uint8_t *page_first_byte = (uint8_t *)(page * PGSIZE);
-    if (get_byte (page_first_byte) == -1)
-    {
+    if (!page_verify (page, write))
       process_kill ();
-    }
   }
-  return;
 }
 
 /* Verifies that size memory at ptr is valid */
 static void
-memory_verify_write (void *ptr, size_t size)
+memory_verify (void *ptr, size_t size)
 {
-  if (size == 0) return;
-  /*Get the first page this data spans */
-  uint32_t start_page = (uint32_t)ptr / PGSIZE;
+  memory_verify_range (ptr, size, false);
+}
 
-  /*Get the last page this data spans */
-  uint32_t end_page = (uint32_t)(ptr + size - 1) / PGSIZE;
+/* Verifies that size memory at ptr is valid and writable */
+static void
+memory_verify_write (void *ptr, size_t size)
+{
+  memory_verify_range (ptr, size, true);
+}
 
-  /* Check the first byte of each page */
-  uint32_t page;
-  for (page = start_page; page <= end_page; page++)
-  {
-    uint8_t *page_first_byte = (uint8_t *)(page * PGSIZE);
-    if ((void *)page_first_byte < ptr) page_first_byte = ptr;
-    if (put_byte (page_first_byte, '\0') == -1)
-    {
-      process_kill ();
-    }
-  }
-  return;
+/* Returns true if the 32-bit word W contains a zero byte. */
+static inline bool
+word_has_zero (uint32_t w)
+{
+  return ((w - 0x01010101) & ~w & 0x80808080) != 0;
 }
 
-/* Verifies that an entire string is vald memory */
+/* Verifies that an entire string is valid memory.  Each page the
+   string touches is checked once, and the terminator is searched
+   for a word at a time. */
 static void
 memory_verify_string (const char *str)
 {
+  const char *p = str;
+
   while (true)
   {
-    int result = get_byte ((unsigned char*)str);
-    if (result == -1)
+    const char *end = (const char *)pg_round_down (p) + PGSIZE;
+    if (!page_verify (pg_round_down (p), false))
       process_kill ();
-    else if ((char)result == '\0')
-      return;
-    str++;
+
+    while (((uintptr_t)p & (sizeof (uint32_t) - 1)) != 0)
+    {
+      if (*p == '\0')
+        return;
+      p++;
+    }
+    while (p < end && !word_has_zero (*(const uint32_t *)p))
+      p += sizeof (uint32_t);
+    for (; p < end; p++)
+      if (*p == '\0')
+        return;
   }
 }
 
@@ -274,37 +380,6 @@ sys_wait (const struct intr_frame *f UNUSED)
   return process_wait (frame_arg_int (f, 1));
 }
 
-/* Check to see if filename is our hash table. The fd_all_lock must be held
- * prior to calling. */
-static struct fd_hash* get_fd_hash (int inumber)
-{
-  ASSERT (lock_held_by_current_thread (&fd_all_lock));
-
-  struct fd_hash fd_sample = {.inumber = inumber};
-  struct hash_elem *elem = hash_find (&fd_all, &fd_sample.elem);
-  struct fd_hash *fd_found = NULL;
-  if (elem != NULL) fd_found = hash_entry (elem, struct fd_hash, elem);
-
-  return fd_found;
-}
-
-
-/* If relative path, make sure cwd is not marked for deletion */
-static bool
-cwd_deleted (const char *filename)
-{
-  struct fd_hash *fd_found = NULL;
-
-  if (filename[0] != '/')
-  {
-    lock_acquire (&fd_all_lock);
-    fd_found = get_fd_hash (thread_get_cwd ());
-    lock_release (&fd_all_lock);
-    if (fd_found != NULL) return true;
-  }
-  return false;
-}
-
 static bool
 sys_create (const struct intr_frame *f)
 {
@@ -313,83 +388,49 @@ sys_create (const struct intr_frame *f)
 
   memory_verify_string (filename);
 
-  if (cwd_deleted (filename)) return false;
-
   return filesys_create (filename, initial_size);
 }
 
 static bool
 sys_remove (const struct intr_frame *f)
 {
-  ASSERT (!lock_held_by_current_thread (&fd_all_lock));
-
   const char *filename = frame_arg_ptr (f, 1);
   memory_verify_string (filename);
 
-  struct file* file = filesys_open (filename);
-  if (file == NULL) return -1;
-  int inumber = file_inumber (file);
-  file_close (file);
-
-  lock_acquire (&fd_all_lock);
-  struct fd_hash *fd_found = get_fd_hash (inumber);
+  return filesys_remove (filename);
+}
 
-  bool result = false;
-  /* Only entries with count > 0 are stored */
-  if (fd_found)
-  {
-    fd_found->delete = true;
-    result = true;
-  } else {
-    result = filesys_remove (filename);
-  }
-  lock_release (&fd_all_lock);
+/* Installs FILE in the current process's descriptor table.  Closes
+   FILE and returns -1 on failure. */
+static int
+syscall_add_file (struct file *file)
+{
+  int fd = process_add_file (thread_current (), file);
+  if (fd == -1)
+    file_close (file);
 
-  return result;
+  return fd;
 }
 
 int
 syscall_open (const char *filename)
 {
-  ASSERT (!lock_held_by_current_thread (&fd_all_lock));
-
-  struct fd_hash *fd_found;
   struct file* file;
 
-  if (cwd_deleted (filename)) return -1;
-
   file = filesys_open (filename);
   if (file == NULL) return -1;
 
-  lock_acquire (&fd_all_lock);
-  fd_found = get_fd_hash (file_inumber (file));
-
-  /* Update count */
-  if (fd_found == NULL)
-  {
-    fd_found = fd_hash_init ();
-    if (fd_found == NULL)
-    {
-      lock_release (&fd_all_lock);
-      return -1;
-    }
-    fd_found->inumber = file_inumber (file);
-    hash_insert (&fd_all, &fd_found->elem);
-  }
-  /* Makes sure it isn't marked for deletion */
-  if (fd_found->delete)
-  {
-    lock_release (&fd_all_lock);
-    return -1;
-  }
-
-  fd_found->count++;
-  lock_release (&fd_all_lock);
+  return syscall_add_file (file);
+}
 
-  int fd = process_add_file (thread_current (),
-                             file, filename);
+/* Opens a new, independent descriptor for the same inode as FILE. */
+int
+syscall_reopen (struct file *file)
+{
+  file = file_reopen (file);
+  if (file == NULL) return -1;
 
-  return fd;
+  return syscall_add_file (file);
 }
 
 static int
@@ -439,30 +480,17 @@ sys_tell (struct intr_frame *f)
 void
 syscall_close (int fd)
 {
-  ASSERT (!lock_held_by_current_thread (&fd_all_lock));
-
-  struct process_fd *pfd = process_get_file (thread_current (), fd);
+  struct process_fd *pfd = process_get_fd (thread_current (), fd);
   if (pfd == NULL) {
     return;
   }
 
-  lock_acquire (&fd_all_lock);
-  struct fd_hash *fd_found = get_fd_hash (file_inumber (pfd->file));
-  if (fd_found == NULL)
-  {
-    lock_release (&fd_all_lock);
-    return;
-  }
-  file_close (pfd->file);
-
-  /* Perform syscall level bookkeeping */
-  fd_found->count--;
-  if (fd_found->count == 0)
-  {
-    if (fd_found->delete) filesys_remove (pfd->filename);
-    fd_hash_destroy(fd_found);
-  }
-  lock_release (&fd_all_lock);
+  if (pfd->pipe != NULL)
+    pipe_close (pfd->pipe, pfd->pipe_writer);
+  else if (pfd->shm != NULL)
+    shm_close (pfd->shm);
+  else
+    file_close (pfd->file);
 
   /* Remove the file from the process */
   process_remove_file (thread_current (), fd);
@@ -541,6 +569,38 @@ sys_readdir (struct intr_frame *f)
   return result;
 }
 
+/**
+ * Reads up to count entries from directory fd into the array of struct
+ * dirent at entries, each with its name, inode number and whether it is a
+ * directory. Returns the number of entries read, 0 if no entries are left,
+ * or -1 if fd is not a directory.
+ */
+static int
+sys_getdents (struct intr_frame *f)
+{
+  int fd = frame_arg_int (f, 1);
+  struct dirent *entries = frame_arg_ptr (f, 2);
+  unsigned count = frame_arg_int (f, 3);
+  unsigned i;
+
+  if (count > PGSIZE / sizeof *entries)
+    count = PGSIZE / sizeof *entries;
+  memory_verify (entries, count * sizeof *entries);
+  memory_verify_write (entries, count * sizeof *entries);
+
+  struct process_fd *pfd = process_get_file (thread_current (), fd);
+  if (pfd == NULL || !file_is_directory (pfd->file)) return -1;
+
+  for (i = 0; i < count; i++)
+  {
+    struct dirent e;
+    if (!file_readdir_entry (pfd->file, e.name, &e.inumber, &e.is_dir))
+      break;
+    memcpy (&entries[i], &e, sizeof e);
+  }
+  return i;
+}
+
 /**
  * Returns true if fd represents a directory, false if it represents an
  * ordinary file.
@@ -571,44 +631,196 @@ sys_inumber (struct intr_frame *f)
   return file_inumber (pfd->file);
 }
 
-/* This function performs some file operation one page at a time so
-   that we do not need to worry about having a frame removed from
-   under us */
+/* Copies the information about INODE into the user's ST, which
+   must have been verified */
+static void
+stat_inode (struct inode *inode, struct stat *st)
+{
+  struct stat kst;
+
+  kst.size = inode_length (inode);
+  kst.inumber = inode_get_inumber (inode);
+  kst.is_dir = inode_is_directory (inode);
+  kst.nlink = 1;                /* There are no hard links */
+  memcpy (st, &kst, sizeof kst);
+}
+
+/**
+ * Stores the size, inode number, link count and type of the file or
+ * directory at path into st, without opening a file descriptor. Returns true
+ * if successful, false if path does not exist.
+ */
+static bool
+sys_stat (struct intr_frame *f)
+{
+  const char *path = frame_arg_ptr (f, 1);
+  struct stat *st = frame_arg_ptr (f, 2);
+  memory_verify_string (path);
+  memory_verify (st, sizeof *st);
+  memory_verify_write (st, sizeof *st);
+
+  struct inode *inode = filesys_lookup (path);
+  if (inode == NULL) return false;
+
+  stat_inode (inode, st);
+  inode_close (inode);
+  return true;
+}
+
+/**
+ * Stores the size, inode number, link count and type of the file or
+ * directory open as fd into st. Returns true if successful, false if fd is
+ * not open.
+ */
+static bool
+sys_fstat (struct intr_frame *f)
+{
+  int fd = frame_arg_int (f, 1);
+  struct stat *st = frame_arg_ptr (f, 2);
+  memory_verify (st, sizeof *st);
+  memory_verify_write (st, sizeof *st);
+
+  struct process_fd *pfd = process_get_file (thread_current (), fd);
+  if (pfd == NULL) return false;
+
+  stat_inode (file_get_inode (pfd->file), st);
+  return true;
+}
+
+/* Largest number of user pages pinned at once by safe_file_block_ops */
+#define SAFE_BLOCK_PAGES 16
+
+/* Offset telling safe_file_block_ops to use the file's own position */
+#define FILE_POS_CURRENT -1
+
+/* This function performs some file operation directly between the
+   buffer cache and the user's buffer.  The pages under it are pinned
+   up to SAFE_BLOCK_PAGES at a time, so that we do not need to worry
+   about having a frame removed from under us, or about faulting
+   while the file system holds its locks.  The operation starts at
+   byte ofs of the file, or at its current position if ofs is
+   FILE_POS_CURRENT.  If pinned is true the caller has already pinned
+   all of buffer, and no pages are pinned here. */
 static int
-safe_file_block_ops (struct file *file, char *buffer, size_t size, bool write)
+safe_file_block_ops (struct file *file, char *buffer, size_t size,
+                     off_t ofs, bool write, bool pinned)
 {
   size_t size_accum = 0;
-  bool read = !write;
-
-  char *tmp_buf = malloc(PGSIZE);
-  if (tmp_buf == NULL) return -1;
 
   while (size_accum < size)
   {
+    char *cur_buff = buffer + size_accum;
+    char *cur_end = (char *) pg_round_down (cur_buff)
+                    + SAFE_BLOCK_PAGES * PGSIZE;
     int cur_size = size - size_accum;
-    if (cur_size > PGSIZE) cur_size = PGSIZE;
+    if (cur_size > cur_end - cur_buff) cur_size = cur_end - cur_buff;
 
-    char *cur_buff = buffer + size_accum;
+    if (!pinned && !page_pin_range (cur_buff, cur_size, !write))
+      process_kill ();
 
-    if (write)
-      memcpy(tmp_buf, cur_buff, cur_size);
     int op_result;
-    if (read)
-      op_result = file_read (file, tmp_buf, cur_size);
+    if (ofs == FILE_POS_CURRENT)
+      op_result = write ? file_write (file, cur_buff, cur_size)
+                        : file_read (file, cur_buff, cur_size);
     else
-      op_result = file_write (file, tmp_buf, cur_size);
+      op_result = write
+        ? file_write_at (file, cur_buff, cur_size, ofs + size_accum)
+        : file_read_at (file, cur_buff, cur_size, ofs + size_accum);
 
-    if (read)
-      memcpy(cur_buff, tmp_buf, cur_size);
+    if (!pinned)
+      page_unpin_range (cur_buff, cur_size);
 
     size_accum += op_result;
 
     if (op_result != cur_size) break;
   }
-  free(tmp_buf);
   return size_accum;
 }
 
+/* Reads size bytes from the keyboard into buffer */
+static int
+console_read (char *buffer, size_t size)
+{
+  size_t read_size = 0;
+  while (read_size < size) {
+    buffer[read_size] = input_getc ();
+    read_size++;
+  }
+  return read_size;
+}
+
+/* Like safe_file_block_ops, but moves data between pipe and the
+   user's buffer a page at a time, pinning each page while the pipe's
+   lock is held.  A read waits only until the first data arrives, so
+   it returns whatever the writer has produced so far, and does not
+   wait at all unless block is true.  pinned is as for
+   safe_file_block_ops. */
+static int
+safe_pipe_ops (struct pipe *pipe, char *buffer, size_t size, bool write,
+               bool block, bool pinned)
+{
+  size_t size_accum = 0;
+
+  while (size_accum < size)
+  {
+    char *cur_buff = buffer + size_accum;
+    int cur_size = size - size_accum;
+    if (cur_size > PGSIZE) cur_size = PGSIZE;
+
+    if (!pinned && !page_pin_range (cur_buff, cur_size, !write))
+      process_kill ();
+
+    int op_result = write
+      ? pipe_write (pipe, cur_buff, cur_size)
+      : pipe_read (pipe, cur_buff, cur_size, block && size_accum == 0);
+
+    if (!pinned)
+      page_unpin_range (cur_buff, cur_size);
+
+    if (op_result < 0)
+      return size_accum > 0 ? (int) size_accum : -1;
+    size_accum += op_result;
+
+    if (op_result != cur_size) break;
+  }
+  return size_accum;
+}
+
+/* Reads or writes size bytes between buffer and fd at its current
+   position.  fd may be a file, a pipe end, or the console if fd 0 or
+   1 has not been redirected.  A read from an empty pipe waits for data
+   only if block is true, and pinned says whether the caller has
+   already pinned buffer.  Returns the number of bytes transferred, or
+   -1 if fd cannot be used this way. */
+static int
+fd_block_ops (int fd, char *buffer, size_t size, bool write, bool block,
+              bool pinned)
+{
+  struct process_fd *pfd = process_get_fd (thread_current (), fd);
+
+  if (pfd == NULL)
+  {
+    if (fd != (write ? STDOUT_FILENO : STDIN_FILENO))
+      return -1;
+    if (!write)
+      return console_read (buffer, size);
+    putbuf (buffer, size);
+    return size;
+  }
+
+  if (pfd->pipe != NULL)
+  {
+    if (pfd->pipe_writer != write)
+      return -1;
+    return safe_pipe_ops (pfd->pipe, buffer, size, write, block, pinned);
+  }
+  if (pfd->file == NULL)
+    return -1;
+
+  return safe_file_block_ops (pfd->file, buffer, size,
+                              FILE_POS_CURRENT, write, pinned);
+}
+
 static int32_t
 sys_read (struct intr_frame *f)
 {
@@ -619,52 +831,355 @@ sys_read (struct intr_frame *f)
   memory_verify(user_buffer, user_size);
   memory_verify_write (user_buffer, user_size);
 
-  int result = -1;
+  return fd_block_ops (fd, user_buffer, user_size, false, true, false);
+}
 
-  /* Special case for reading from the keyboard */
-  if (fd == 0)
+static int
+sys_write (const struct intr_frame *f)
+{
+  int fd = frame_arg_int (f, 1);
+  const char* buffer = frame_arg_ptr (f, 2);
+  size_t size = frame_arg_int (f, 3);
+  memory_verify ((void *)buffer, size);
+
+  /* A bad fd writes nothing */
+  struct process_fd *pfd = process_get_fd (thread_current (), fd);
+  if (pfd == NULL && fd != STDOUT_FILENO) return 0;
+
+  return fd_block_ops (fd, (char *) buffer, size, true, true, false);
+}
+
+/**
+ * Reads or writes size bytes between buffer and the file open as fd,
+ * starting at byte offset of the file, without using or moving the
+ * file's position.
+ *
+ * Arguments:
+ * - int fd: file descriptor, which may not be the console
+ * - void *buffer: user buffer
+ * - unsigned size: number of bytes to transfer
+ * - int offset: non-negative byte offset into the file
+ * Returns:
+ * - the number of bytes transferred, or -1 on error
+ */
+static int
+sys_pread_pwrite (const struct intr_frame *f, bool write)
+{
+  int fd = frame_arg_int (f, 1);
+  char *buffer = frame_arg_ptr (f, 2);
+  size_t size = frame_arg_int (f, 3);
+  off_t offset = frame_arg_int (f, 4);
+
+  memory_verify_range (buffer, size, !write);
+  if (offset < 0) return -1;
+
+  struct process_fd *pfd = process_get_file (thread_current (), fd);
+  if (pfd == NULL) return -1;
+
+  return safe_file_block_ops (pfd->file, buffer, size, offset, write,
+                              false);
+}
+
+/**
+ * Reads into or writes from the iovcnt buffers described by iov, in
+ * order, at the current position of fd.  Every buffer is validated
+ * before any data moves, so a bad buffer kills the process without a
+ * partial transfer.  If the buffers span at most SAFE_BLOCK_PAGES
+ * pages they are all pinned once up front; a larger vector is pinned
+ * a chunk at a time as each buffer is transferred, so that one call
+ * cannot hold an unbounded number of frames.  Stops at the first short
+ * transfer.  Only the first buffer waits for a pipe to have data, so a
+ * read returns what has arrived once it has something.
+ *
+ * Arguments:
+ * - int fd: file descriptor, pipe end, or the console
+ * - const struct iovec *iov: array of buffers
+ * - int iovcnt: number of buffers, at most IOV_MAX
+ * Returns:
+ * - the total number of bytes transferred, or -1 on error, including
+ *   when the buffer lengths add up to more than INT_MAX
+ */
+static int
+sys_readv_writev (const struct intr_frame *f, bool write)
+{
+  int fd = frame_arg_int (f, 1);
+  const struct iovec *user_iov = frame_arg_ptr (f, 2);
+  int iovcnt = frame_arg_int (f, 3);
+  struct iovec iov[IOV_MAX];
+  size_t sum = 0;
+  size_t page_cnt = 0;
+  bool pinned;
+  int total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX) return -1;
+
+  /* Copy the vector in so that it cannot change under us */
+  memory_verify ((void *)user_iov, iovcnt * sizeof *iov);
+  memcpy (iov, user_iov, iovcnt * sizeof *iov);
+  for (i = 0; i < iovcnt; i++)
   {
-    size_t read_size = 0;
-    while (read_size < user_size) {
-      user_buffer[read_size] = input_getc ();
-      read_size++;
+    char *base = iov[i].iov_base;
+    size_t len = iov[i].iov_len;
+
+    memory_verify_range (base, len, !write);
+    if (len > INT_MAX - sum) return -1;
+    sum += len;
+    if (len > 0)
+      page_cnt += (pg_no (base + len - 1) - pg_no (base)) + 1;
+  }
+
+  pinned = page_cnt <= SAFE_BLOCK_PAGES;
+  if (pinned)
+    for (i = 0; i < iovcnt; i++)
+      if (!page_pin_range (iov[i].iov_base, iov[i].iov_len, !write))
+      {
+        while (i-- > 0)
+          page_unpin_range (iov[i].iov_base, iov[i].iov_len);
+        process_kill ();
+      }
+
+  for (i = 0; i < iovcnt; i++)
+  {
+    size_t size = iov[i].iov_len;
+    int result = fd_block_ops (fd, iov[i].iov_base, size, write,
+                               total == 0, pinned);
+
+    if (result < 0)
+    {
+      if (total == 0) total = -1;
+      break;
     }
+    total += result;
+    if ((size_t) result != size) break;
+  }
 
-    result = read_size;
-  } else {
+  if (pinned)
+    for (i = 0; i < iovcnt; i++)
+      page_unpin_range (iov[i].iov_base, iov[i].iov_len);
+  return total;
+}
+
+/**
+ * Copies up to size bytes from the file open as fd_in to the file open
+ * as fd_out inside the kernel, starting at and advancing each file's
+ * position.
+ *
+ * Arguments:
+ * - int fd_in: file to copy from
+ * - int fd_out: file to copy to, which must be a different file
+ * - unsigned size: number of bytes to copy
+ * Returns:
+ * - the number of bytes copied, which is less than size only at the
+ *   end of fd_in or if fd_out cannot grow, or -1 on error
+ */
+static int
+sys_copy_file_range (const struct intr_frame *f)
+{
+  int fd_in = frame_arg_int (f, 1);
+  int fd_out = frame_arg_int (f, 2);
+  off_t size = frame_arg_int (f, 3);
 
-    struct process_fd *pfd = process_get_file (thread_current (), fd);
-    if (pfd == NULL) return -1;
+  if (size < 0) return -1;
 
-    result = safe_file_block_ops (pfd->file, user_buffer, user_size, false);
-  }
+  struct process_fd *in = process_get_file (thread_current (), fd_in);
+  struct process_fd *out = process_get_file (thread_current (), fd_out);
+  if (in == NULL || out == NULL) return -1;
 
-  return result;
+  return file_copy (out->file, in->file, size);
+}
+
+/**
+ * Registers a page-aligned struct aio_ring shared with the kernel for
+ * asynchronous I/O.
+ *
+ * Arguments:
+ * - struct aio_ring *ring: the ring, which stays pinned until exit
+ * Returns:
+ * - true on success, false if ring is not page-aligned or the process
+ *   already has a ring
+ */
+static bool
+sys_aio_setup (const struct intr_frame *f)
+{
+  struct aio_ring *ring = frame_arg_ptr (f, 1);
+
+  memory_verify_range (ring, sizeof *ring, true);
+  return aio_setup (ring);
 }
 
+/**
+ * Submits entries from the submission queue of the process's aio_ring
+ * and waits for completions.
+ *
+ * Arguments:
+ * - unsigned to_submit: most entries to take from the submission queue
+ * - unsigned min_complete: completions to wait for, counting those not
+ *   yet reaped
+ * Returns:
+ * - the number of entries submitted, or -1 if there is no ring
+ */
 static int
-sys_write (const struct intr_frame *f)
+sys_aio_submit (const struct intr_frame *f)
+{
+  unsigned to_submit = frame_arg_int (f, 1);
+  unsigned min_complete = frame_arg_int (f, 2);
+
+  return aio_submit (to_submit, min_complete);
+}
+
+/**
+ * Advises the kernel how a range of an open file will be accessed.
+ *
+ * Arguments:
+ * - int fd: the file
+ * - unsigned offset: start of the range
+ * - unsigned size: size of the range, or 0 for the rest of the file
+ * - int advice: an enum advice
+ * Returns:
+ * - true on success, false if fd is not an open file or advice is
+ *   unknown
+ */
+static bool
+sys_fadvise (const struct intr_frame *f)
 {
   int fd = frame_arg_int (f, 1);
-  const char* buffer = frame_arg_ptr (f, 2);
-  size_t size = frame_arg_int (f, 3);
-  memory_verify ((void *)buffer, size);
+  off_t offset = frame_arg_int (f, 2);
+  off_t size = frame_arg_int (f, 3);
+  int advice = frame_arg_int (f, 4);
+
+  struct process_fd *pfd = process_get_file (thread_current (), fd);
+  if (pfd == NULL || advice < ADV_NORMAL || advice > ADV_DONTNEED)
+    return false;
+
+  return file_advise (pfd->file, offset, size, advice);
+}
+
+/**
+ * Advises the kernel how a range of the process's memory will be
+ * accessed.
+ *
+ * Arguments:
+ * - void *addr: start of the range, which must be page-aligned
+ * - unsigned size: size of the range
+ * - int advice: an enum advice
+ * Returns:
+ * - true on success, false if addr is not page-aligned, part of the
+ *   range is not mapped or advice is unknown
+ */
+static bool
+sys_madvise (const struct intr_frame *f)
+{
+  void *addr = frame_arg_ptr (f, 1);
+  size_t size = frame_arg_int (f, 2);
+  int advice = frame_arg_int (f, 3);
+
+  if (pg_ofs (addr) != 0 || advice < ADV_NORMAL || advice > ADV_DONTNEED
+      || (uint8_t *) addr + size > (uint8_t *) PHYS_BASE
+      || (uint8_t *) addr + size < (uint8_t *) addr)
+    return false;
+
+  return page_advise (addr, size, advice);
+}
+
+/**
+ * Reads the profile of one system call, kept when the kernel runs with
+ * -sp.
+ *
+ * Arguments:
+ * - int number: the system call number
+ * - bool all: whether to read the system-wide profile rather than the
+ *   calling process's
+ * - struct syscall_stat *st: filled in with the profile
+ * Returns:
+ * - true on success, false if profiling is off or number is unknown
+ */
+static bool
+sys_sysprof (const struct intr_frame *f)
+{
+  uint32_t number = frame_arg_int (f, 1);
+  bool all = frame_arg_int (f, 2);
+  struct syscall_stat *st = frame_arg_ptr (f, 3);
+
+  memory_verify_write (st, sizeof *st);
+  if (!syscall_profile || number >= SYSCALL_CNT)
+    return false;
 
-  // Handle special case for writing to the console
-  if (fd == 1)
+  struct syscall_stat stat = {0, 0, 0};
+  struct thread *t = thread_current ();
+  if (all)
   {
-    putbuf (buffer, size);
-    return size;
+    enum intr_level old_level = intr_disable ();
+    stat = syscall_stats[number];
+    intr_set_level (old_level);
   }
+  else if (t->syscall_stats != NULL)
+    stat = t->syscall_stats[number];
 
-  // Handle rest of file descriptors
-  struct process_fd *pfd = process_get_file (thread_current (), fd);
-  if (pfd == NULL) return 0;
+  *st = stat;
+  return true;
+}
+
+/**
+ * Creates a pipe and opens both of its ends.  Data written to the
+ * write end can be read from the read end, in order; a pipe holds one
+ * page, so writers wait for readers and readers wait for writers.
+ *
+ * Arguments:
+ * - int fds[2]: set to the fd of the read end and of the write end
+ * Returns:
+ * - true on success, false if memory is exhausted
+ */
+static bool
+sys_pipe (const struct intr_frame *f)
+{
+  int *fds = frame_arg_ptr (f, 1);
+  memory_verify_write (fds, 2 * sizeof *fds);
 
-  int result = safe_file_block_ops
-    (pfd->file, (void*)buffer, size, true);
+  struct pipe *pipe = pipe_create ();
+  if (pipe == NULL) return false;
 
-  return result;
+  struct thread *t = thread_current ();
+  int read_fd = process_add_pipe (t, pipe, false);
+  if (read_fd == -1)
+  {
+    pipe_close (pipe, false);
+    pipe_close (pipe, true);
+    return false;
+  }
+  int write_fd = process_add_pipe (t, pipe, true);
+  if (write_fd == -1)
+  {
+    syscall_close (read_fd);
+    pipe_close (pipe, true);
+    return false;
+  }
+
+  fds[0] = read_fd;
+  fds[1] = write_fd;
+  return true;
+}
+
+/**
+ * Makes newfd refer to the file or pipe end open as oldfd, closing
+ * newfd first if it is open.  Redirecting fd 0 or 1 replaces the
+ * console until it is closed, and is inherited by processes started
+ * with exec, which is how a shell connects a pipeline.
+ *
+ * Arguments:
+ * - int oldfd: file descriptor to duplicate, which may not be the
+ *   console
+ * - int newfd: file descriptor to replace
+ * Returns:
+ * - newfd, or -1 if oldfd is not open, newfd is out of range or memory
+ *   is exhausted
+ */
+static int
+sys_dup2 (const struct intr_frame *f)
+{
+  int oldfd = frame_arg_int (f, 1);
+  int newfd = frame_arg_int (f, 2);
+  return process_dup_fd (thread_current (), oldfd, newfd);
 }
 
 static int
@@ -682,7 +1197,7 @@ sys_mmap (struct intr_frame *f)
   struct process_fd *pfd = process_get_file (t, fd);
   if (pfd == NULL) return -1;
 
-  struct process_mmap *mmap = mmap_create (pfd->filename);
+  struct process_mmap *mmap = mmap_create (pfd->file);
   if (mmap == NULL) return -1;
 
   /* Break file into pages, making sure to note the number of zeros
@@ -716,14 +1231,112 @@ sys_munmap (struct intr_frame *f UNUSED)
   process_remove_mmap (id);
 }
 
-/* Registers the system call handler for internal interrupts. */
+/**
+ * Opens the shared memory segment called name, creating it if no
+ * segment has that name. Processes that map the same segment share its
+ * pages, which are swapped like any other memory. A segment lasts until
+ * no process has it open or mapped.
+ *
+ * Arguments:
+ * - const char *name: name of the segment, at most SHM_NAME_MAX bytes
+ * - unsigned size: size of a new segment, which is rounded up to whole
+ *   pages and zero-filled; ignored if the segment exists
+ * Returns:
+ * - a file descriptor for the segment, or -1 if it cannot be opened
+ */
+static int
+sys_shm_open (const struct intr_frame *f)
+{
+  const char *name = frame_arg_ptr (f, 1);
+  size_t size = frame_arg_int (f, 2);
+  memory_verify_string (name);
+
+  struct shm *shm = shm_open (name, size);
+  if (shm == NULL) return -1;
+
+  int fd = process_add_shm (thread_current (), shm);
+  if (fd == -1)
+    shm_close (shm);
+  return fd;
+}
+
+/**
+ * Maps the whole shared memory segment open as fd at addr. The mapping
+ * stays after fd is closed, and is removed with munmap().
+ *
+ * Arguments:
+ * - int fd: file descriptor from shm_open()
+ * - void *addr: page-aligned user address to map at, which must not
+ *   be NULL
+ * Returns:
+ * - a mapid_t for the mapping, or -1 if fd is not a shared memory
+ *   segment or the pages at addr are not free
+ */
+static int
+sys_shm_map (const struct intr_frame *f)
+{
+  int fd = frame_arg_int (f, 1);
+  uint8_t *uaddr = frame_arg_ptr (f, 2);
+
+  if (pg_ofs (uaddr) != 0 || uaddr == NULL || !is_user_vaddr (uaddr))
+    return -1;
+
+  struct process_fd *pfd = process_get_fd (thread_current (), fd);
+  if (pfd == NULL || pfd->shm == NULL) return -1;
+
+  size_t page_cnt = shm_page_cnt (pfd->shm);
+  if (page_cnt > (size_t) ((uint8_t *) PHYS_BASE - uaddr) / PGSIZE)
+    return -1;
+
+  struct process_mmap *mmap = mmap_create_shm (pfd->shm);
+  if (mmap == NULL) return -1;
+
+  size_t i;
+  for (i = 0; i < page_cnt; i++)
+    if (!mmap_add_shm (mmap, uaddr + i * PGSIZE, i))
+    {
+      mmap_destroy (mmap);
+      return -1;
+    }
+
+  return process_add_mmap (mmap);
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
+/* Registers the system call handler for internal interrupts, and for
+   sysenter if the CPU supports it. */
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 
-  hash_init (&fd_all, hash_hash_fd_hash, hash_less_fd_hash, NULL);
-  lock_init (&fd_all_lock);
+  /* sysexit returns to the selectors 16 and 24 bytes past
+     SEL_KCSEG, which are SEL_UCSEG and SEL_UDSEG */
+  if (sysenter_supported ())
+  {
+    wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+    wrmsr (MSR_SYSENTER_ESP, (uint32_t) tss_get_esp0 ());
+    wrmsr (MSR_SYSENTER_EIP, (uint32_t) syscall_sysenter_entry);
+  }
+}
+
+/* Handles a system call entered through sysenter, with the system
+   call number in the user stack at ESP and EAX as the user left it.
+   Returns the value for the user's EAX. Only the members of the
+   interrupt frame that system calls use are filled in. */
+uint32_t
+syscall_sysenter (uint32_t eax, void *esp)
+{
+  struct intr_frame f = {.eax = eax, .esp = esp};
+
+  syscall_handler (&f);
+  return f.eax;
 }
 
 /* Handles system calls using the internal interrupt mechanism. The
@@ -731,15 +1344,20 @@ syscall_init (void)
 static void
 syscall_handler (struct intr_frame *f)
 {
-  /* Integrity-check the return pointer */
-  memory_verify ((void*)f->esp, sizeof (void*));
 #ifdef VM
   thread_current ()->saved_esp = f->esp;
   thread_current ()->syscall_context = true;
 #endif
+  /* Integrity-check the return pointer */
+  memory_verify ((void*)f->esp, sizeof (void*));
   uint32_t syscall = get_frame_syscall (f);
   uint32_t eax = f->eax;
 
+  bool profile = syscall_profile && syscall < SYSCALL_CNT;
+  uint64_t start, blocked;
+  if (profile)
+    syscall_profile_begin (syscall, &start, &blocked);
+
   switch (syscall)
   {
   case SYS_HALT:
@@ -796,13 +1414,66 @@ syscall_handler (struct intr_frame *f)
   case SYS_INUMBER:
     eax = sys_inumber (f);
     break;
+  case SYS_GETDENTS:
+    eax = sys_getdents (f);
+    break;
+  case SYS_STAT:
+    eax = sys_stat (f);
+    break;
+  case SYS_FSTAT:
+    eax = sys_fstat (f);
+    break;
+  case SYS_PREAD:
+    eax = sys_pread_pwrite (f, false);
+    break;
+  case SYS_PWRITE:
+    eax = sys_pread_pwrite (f, true);
+    break;
+  case SYS_READV:
+    eax = sys_readv_writev (f, false);
+    break;
+  case SYS_WRITEV:
+    eax = sys_readv_writev (f, true);
+    break;
+  case SYS_COPY_FILE_RANGE:
+    eax = sys_copy_file_range (f);
+    break;
+  case SYS_AIO_SETUP:
+    eax = sys_aio_setup (f);
+    break;
+  case SYS_AIO_SUBMIT:
+    eax = sys_aio_submit (f);
+    break;
+  case SYS_FADVISE:
+    eax = sys_fadvise (f);
+    break;
+  case SYS_MADVISE:
+    eax = sys_madvise (f);
+    break;
   case SYS_MMAP:
     eax = sys_mmap (f);
     break;
   case SYS_MUNMAP:
     sys_munmap (f);
     break;
+  case SYS_SYSPROF:
+    eax = sys_sysprof (f);
+    break;
+  case SYS_PIPE:
+    eax = sys_pipe (f);
+    break;
+  case SYS_DUP2:
+    eax = sys_dup2 (f);
+    break;
+  case SYS_SHM_OPEN:
+    eax = sys_shm_open (f);
+    break;
+  case SYS_SHM_MAP:
+    eax = sys_shm_map (f);
+    break;
   }
+  if (profile)
+    syscall_profile_end (syscall, start, blocked);
   thread_current ()->syscall_context = false;
   /* Set return value */
   f->eax = eax;
@@ -1,10 +1,104 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #define READDIR_MAX_LEN 14
 
+struct file;
+
+/* Directory entry filled in by getdents(). Must match the layout in
+   lib/user/syscall.h. */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Is it a directory? */
+    char name[READDIR_MAX_LEN + 1];     /* Null-terminated file name. */
+  };
+
+/* File information filled in by stat() and fstat(). Must match the
+   layout in lib/user/syscall.h. */
+struct stat
+  {
+    int size;                           /* Size in bytes. */
+    int inumber;                        /* Inode number. */
+    int nlink;                          /* Number of links. */
+    bool is_dir;                        /* Is it a directory? */
+  };
+
+/* Largest number of buffers passed to readv() or writev(). */
+#define IOV_MAX 32
+
+/* Buffer for readv() and writev(). Must match the layout in
+   lib/user/syscall.h. */
+struct iovec
+  {
+    void *iov_base;                     /* Start of buffer. */
+    size_t iov_len;                     /* Size in bytes. */
+  };
+
+/* Number of entries in each queue of an aio_ring. */
+#define AIO_RING_ENTRIES 32
+
+/* Operations an aio_sqe may request. */
+enum aio_opcode
+  {
+    AIO_READ,                           /* Read from a file. */
+    AIO_WRITE,                          /* Write to a file. */
+    AIO_FSYNC                           /* Write dirty blocks to disk. */
+  };
+
+/* Submission queue entry. Must match the layout in lib/user/syscall.h. */
+struct aio_sqe
+  {
+    int opcode;                         /* An enum aio_opcode. */
+    int fd;                             /* File to operate on. */
+    void *buf;                          /* Start of buffer. */
+    unsigned size;                      /* Size in bytes. */
+    unsigned offset;                    /* File offset to start at. */
+    unsigned user_data;                 /* Copied to the completion. */
+  };
+
+/* Completion queue entry. Must match the layout in lib/user/syscall.h. */
+struct aio_cqe
+  {
+    unsigned user_data;                 /* From the submission. */
+    int result;                         /* Bytes transferred, or -1. */
+  };
+
+/* Submission and completion queues shared by a process and the
+   kernel, registered with aio_setup(). The process fills sq[] and
+   advances sq_tail, the kernel advances sq_head as it takes entries,
+   fills cq[] and advances cq_tail, and the process advances cq_head
+   as it reaps completions. Indices run freely and are reduced modulo
+   AIO_RING_ENTRIES. Must match the layout in lib/user/syscall.h. */
+struct aio_ring
+  {
+    unsigned sq_head, sq_tail;          /* Submission queue indices. */
+    unsigned cq_head, cq_tail;          /* Completion queue indices. */
+    struct aio_sqe sq[AIO_RING_ENTRIES];
+    struct aio_cqe cq[AIO_RING_ENTRIES];
+  };
+
+/* System call profile returned by sysprof(), in time-stamp counter
+   cycles. Must match the layout in lib/user/syscall.h. */
+struct syscall_stat
+  {
+    uint64_t count;                     /* Number of calls. */
+    uint64_t cycles;                    /* Cycles spent in the handler. */
+    uint64_t blocked;                   /* Part of CYCLES spent blocked. */
+  };
+
+/* -sp: Profile system calls. */
+extern bool syscall_profile;
+
 void syscall_init (void);
+void syscall_profile_exit (void);
+void syscall_print_stats (void);
 void syscall_close (int fd);
 int syscall_open (const char *filename);
+int syscall_reopen (struct file *file);
 
 #endif /* userprog/syscall.h */
@@ -4,6 +4,7 @@
 #include "userprog/pagedir.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/shm.h"
 
 static struct list_elem *clock_hand; /* The hand of the clock algorithm */
 static struct list frames;     /* List of frame_entry for active frames */
@@ -37,8 +38,10 @@ frame_create (struct thread *t, struct s_page_entry *spe, uint8_t *kpage)
   /* Populate fields */
   f->t = t;
   f->spe = spe;
+  f->shared = NULL;
   f->kaddr = kpage;
   f->pinned = true;
+  f->pin_cnt = 0;
 
   /* Insert into list */
   lock_acquire (&frames_lock);
@@ -59,7 +62,29 @@ frame_pin_no_lock (struct frame_entry *f)
 }
 
 /**
- * Acquires the frames_lock and unpins a frame.
+ * Acquires the frames_lock and pins a frame so that it cannot be evicted.
+ * Pins taken this way nest, so the same page may be pinned by several
+ * pending operations. Returns false if the frame is pinned because it is
+ * being loaded or evicted.
+ */
+bool
+frame_pin (struct frame_entry *f)
+{
+  ASSERT (!lock_held_by_current_thread (&frames_lock));
+  lock_acquire (&frames_lock);
+  bool success = f->pin_cnt > 0 || !f->pinned;
+  if (success)
+  {
+    f->pinned = true;
+    f->pin_cnt++;
+  }
+  lock_release (&frames_lock);
+  return success;
+}
+
+/**
+ * Acquires the frames_lock and unpins a frame, or drops one of the pins
+ * taken by frame_pin().
  */
 void
 frame_unpin (struct frame_entry *f)
@@ -67,7 +92,37 @@ frame_unpin (struct frame_entry *f)
   ASSERT (!lock_held_by_current_thread (&frames_lock));
   lock_acquire (&frames_lock);
   ASSERT (f->pinned);
-  f->pinned = false;
+  if (f->pin_cnt == 0 || --f->pin_cnt == 0)
+    f->pinned = false;
+  lock_release (&frames_lock);
+}
+
+/**
+ * Makes the frame holding the current thread's page spe, if any, the
+ * next one the clock algorithm evicts. No lock on spe is needed: the
+ * process's frames are freed only by the process itself, and under the
+ * frames_lock an unpinned frame that still holds spe cannot be evicted.
+ */
+void
+frame_deprioritize (struct s_page_entry *spe)
+{
+  lock_acquire (&frames_lock);
+  struct frame_entry *f = spe->frame;
+  if (f != NULL && f->spe == spe && f->t == thread_current ()
+      && !f->pinned)
+  {
+    pagedir_set_accessed (f->t->pagedir, spe->uaddr, false);
+
+    /* The clock looks at the frame after the hand first */
+    if (&f->elem != clock_hand)
+    {
+      list_remove (&f->elem);
+      if (clock_hand == list_end (&frames))
+        list_push_front (&frames, &f->elem);
+      else
+        list_insert (list_next (clock_hand), &f->elem);
+    }
+  }
   lock_release (&frames_lock);
 }
 
@@ -85,13 +140,43 @@ clock_next (void)
   return clock_hand;
 }
 
+/**
+ * Returns whether the clock algorithm may evict f, clearing its accessed
+ * bits if it was recently used. If force is true, the accessed bits are
+ * ignored. A shared frame also needs its page's lock, which is left held
+ * for the eviction if it is chosen; if another thread holds it, the page
+ * is in use and the frame is passed over.
+ */
+static bool
+clock_select (struct frame_entry *f, bool force)
+{
+  if (f->pinned)
+    return false;
+
+  if (f->shared == NULL)
+  {
+    if (force || !pagedir_is_accessed (f->t->pagedir, f->spe->uaddr))
+      return true;
+    pagedir_set_accessed (f->t->pagedir, f->spe->uaddr, false);
+    return false;
+  }
+
+  if (lock_held_by_current_thread (&f->shared->l)
+      || !lock_try_acquire (&f->shared->l))
+    return false;
+  if (force || !shm_page_accessed (f->shared))
+    return true;
+  lock_release (&f->shared->l);
+  return false;
+}
+
 /**
  * Uses the clock algorithm to find the next frame for eviction. The
  * criteria are that the frame is untagged . After one revolution at least
  * one frame should be untagged.
  *
  * The frames_lock must be acquired before entering this method. Returns a
- * pinned frame. 
+ * pinned frame, with its page's lock held if it is shared.
  */
 static struct frame_entry *
 clock_algorithm (void)
@@ -114,17 +199,19 @@ clock_algorithm (void)
   }
   clock_start = f;
 
-  /* Run clock algorithm */
-  do {
-    if (!f->pinned)
+  /* Run clock algorithm.  Once around, the accessed bits are clear and
+     the first frame that can be evicted is taken. */
+  bool force = false;
+  while (!clock_select (f, force))
+  {
+    f = list_entry (clock_next (), struct frame_entry, elem);
+    if (f == clock_start)
     {
-      if (pagedir_is_accessed (f->t->pagedir, f->spe->uaddr))
-	pagedir_set_accessed (f->t->pagedir, f->spe->uaddr, false);
-      else
-	break;
+      if (force)
+        return NULL;
+      force = true;
     }
-    f = list_entry (clock_next (), struct frame_entry, elem);
-  } while (f != clock_start);
+  }
 
   frame_pin_no_lock (f);
 
@@ -146,6 +233,17 @@ frame_evict (void)
     lock_release (&frames_lock);
     return NULL;	/* Could not find a frame to evict */
   }
+
+  /* A shared page is unmapped from all of its processes.  The clock
+     algorithm left its lock held. */
+  if (f->shared != NULL)
+  {
+    struct shm_page *page = f->shared;
+    lock_release (&frames_lock);
+    shm_page_evict (page);
+    lock_release (&page->l);
+    return f;
+  }
   struct s_page_entry *spe = f->spe;
 
   /* Perform the eviction */
@@ -167,7 +265,8 @@ frame_evict (void)
 /**
  * Allocates a frame and marks it for the given user address. This frame
  * may come from an unallocated frame or the eviction of a
- * previously-allocated frame. The frame will be pinned.
+ * previously-allocated frame. The frame will be pinned. spe is NULL for
+ * a frame that will hold a shared page; the caller sets its shared field.
  */
 struct frame_entry*
 frame_get (struct s_page_entry *spe, enum vm_flags flags)
@@ -188,6 +287,7 @@ frame_get (struct s_page_entry *spe, enum vm_flags flags)
     /* Associate with new thread */
     f->t = thread_current ();
     f->spe = spe;
+    f->shared = NULL;
 
     /* Zero out the page if requested */
     if (flags & PAL_ZERO)
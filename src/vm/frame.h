@@ -9,18 +9,21 @@
 struct frame_entry
 {
   struct thread *t;		/* Owner thread */
-  struct s_page_entry *spe;	/* Owner page entry */
+  struct s_page_entry *spe;	/* Owner page entry, unless shared */
+  struct shm_page *shared;	/* Shared page held instead, or NULL */
   uint8_t *kaddr;		/* Physical address */
   struct list_elem elem;	/* Linked list of frame entries */
   bool pinned;			/* Whether this frame is pinned or not */
+  int pin_cnt;			/* Number of pins taken by frame_pin() */
 };
 
 void frame_init (void);
 struct frame_entry *frame_get (struct s_page_entry *spe, enum vm_flags flags);
 bool frame_free (struct frame_entry *f);
 void frame_install (struct frame_entry *f);
+bool frame_pin (struct frame_entry *f);
 void frame_unpin (struct frame_entry *f);
+void frame_deprioritize (struct s_page_entry *spe);
 void frame_destroy_thread (void);
-void thread_pin_frames (struct thread *t);
 
 #endif /* vm/frame.h */
@@ -7,6 +7,7 @@
 #include "userprog/syscall.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/shm.h"
 #include "vm/swap.h"
 
 static bool page_file (struct s_page_entry *spe);
@@ -103,6 +104,7 @@ create_s_page_entry (uint8_t *uaddr, bool writable)
   struct thread *t = thread_current ();
   spe->uaddr = uaddr;
   spe->writable = writable;
+  spe->advice = ADV_NORMAL;
   spe->frame = NULL;
   lock_init (&spe->l);
 
@@ -133,6 +135,26 @@ vm_add_memory_page (uint8_t *uaddr, bool writable)
   return true;
 }
 
+/**
+ * Adds a supplemental page table entry to the current process that maps
+ * a page of shared memory, writable.
+ */
+bool
+vm_add_shared_page (uint8_t *uaddr, struct shm_page *page)
+{
+  ASSERT ((void*)uaddr < PHYS_BASE);
+  struct s_page_entry *spe = create_s_page_entry (uaddr, true);
+  if (spe == NULL)
+    return false;
+
+  spe->type = SHARED_BASED;
+  spe->info.shared.page = page;
+  spe->info.shared.t = thread_current ();
+  shm_page_attach (spe);
+
+  return true;
+}
+
 /**
  * Constructs a file-based supplemental page table entry.
  */
@@ -196,6 +218,10 @@ vm_free_page (struct s_page_entry *spe)
     if (spe->info.memory.swapped && spe->info.memory.used)
       swap_free (spe->info.memory.swap_begin);
     break;
+  case SHARED_BASED:
+    /* The frame and swap belong to the shared page */
+    shm_page_detach (spe);
+    break;
   default:
     PANIC ("Corrupted page table entry!!");
     break;
@@ -335,12 +361,10 @@ page_unfile (struct s_page_entry *spe)
   ASSERT (info->f != NULL);
 
 
-  /* Read page into memory */
-  off_t old_pos = file_tell (info->f);
-  file_seek (info->f, info->offset);
+  /* Read page into memory, reading ahead as the page was advised */
   int target_bytes = PGSIZE - info->zero_bytes;
-  int bytes_read = file_read (info->f, frame->kaddr, target_bytes);
-  file_seek (info->f, old_pos);
+  int bytes_read = file_read_advised (info->f, frame->kaddr, target_bytes,
+                                      info->offset, spe->advice);
 
   spe->frame = frame;
   if (bytes_read != target_bytes) 
@@ -397,6 +421,66 @@ page_evict (struct thread *t, struct s_page_entry *spe)
   return result;
 }
 
+/**
+ * Loads the page for a locked supplemental page entry into a frame.
+ */
+static bool
+page_load_locked (struct s_page_entry *spe)
+{
+  ASSERT (lock_held_by_current_thread (&spe->l));
+
+  bool result = false;
+  switch (spe->type)
+  {
+  case FILE_BASED:
+    result = page_unfile (spe);
+    break;
+  case MEMORY_BASED:
+    result = page_unswap (spe);
+    break;
+  case SHARED_BASED:
+    result = shm_page_load (spe, false);
+    break;
+  default:
+    PANIC ("Unknown page type!");
+  }
+
+  return result;
+}
+
+/**
+ * Looks up the current thread's supplemental page entry for the page
+ * containing uaddr, or returns NULL if there is none.
+ */
+static struct s_page_entry *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct s_page_entry key = {.uaddr = pg_round_down (uaddr)};
+
+  lock_acquire (&t->s_page_lock);
+  struct hash_elem *e = hash_find (&t->s_page_table, &key.elem);
+  lock_release (&t->s_page_lock);
+
+  return e != NULL ? hash_entry (e, struct s_page_entry, elem) : NULL;
+}
+
+/**
+ * Called after spe was loaded, without its lock held. A page advised
+ * sequential will not be touched again once the page after it is, so
+ * the page before spe is made the first to be evicted.
+ */
+static void
+page_drop_behind (struct s_page_entry *spe)
+{
+  if (spe->advice != ADV_SEQUENTIAL || spe->uaddr == NULL)
+    return;
+
+  struct s_page_entry *prev = page_lookup (spe->uaddr - PGSIZE);
+  if (prev != NULL)
+    frame_deprioritize (prev);
+}
+
 /**
  * Attempts to load a page using the supplemental page table.
  */
@@ -424,20 +508,171 @@ page_load (uint8_t *fault_addr)
   lock_release (&t->s_page_lock);
 
   /* Load the page */
-  bool result = false;
-  switch (spe->type)
-  {
-  case FILE_BASED:
-    result = page_unfile (spe);
-    break;
-  case MEMORY_BASED:
-    result = page_unswap (spe);
-    break;
-  default:
-    PANIC ("Unknown page type!");
-  }
+  bool result = page_load_locked (spe);
 
   lock_release (&spe->l);
 
+  if (result)
+    page_drop_behind (spe);
+
   return result;
 }
+
+/**
+ * Loads the user page containing uaddr if needed and pins its frame, so
+ * that the kernel can access it through uaddr without faulting. Returns
+ * false if there is no such page, or if write is true and it is read-only.
+ */
+static bool
+page_pin (const void *uaddr, bool write)
+{
+  struct s_page_entry *spe = page_lookup (uaddr);
+  if (spe == NULL || (write && !spe->writable))
+    return false;
+
+  /* A shared page's frame is pinned under the shared page's lock */
+  if (spe->type == SHARED_BASED)
+    return shm_page_load (spe, true);
+
+  while (true)
+  {
+    lock_acquire (&spe->l);
+    bool loaded = spe->frame == NULL;
+    if (loaded && !page_load_locked (spe))
+    {
+      lock_release (&spe->l);
+      return false;
+    }
+    bool pinned = frame_pin (spe->frame);
+    lock_release (&spe->l);
+    if (loaded)
+      page_drop_behind (spe);
+    if (pinned)
+      break;
+
+    /* The frame is being evicted.  Let that finish before loading the
+       page back in. */
+    thread_yield ();
+  }
+  return true;
+}
+
+/**
+ * Returns true if the user page containing uaddr has an entry in the
+ * supplemental page table, so that touching it will load it rather than
+ * kill the process. If write is true the page must also be writable.
+ */
+bool
+page_is_valid (const void *uaddr, bool write)
+{
+  struct s_page_entry *spe = page_lookup (uaddr);
+  return spe != NULL && (!write || spe->writable);
+}
+
+/**
+ * Applies advice to the current thread's pages in the size bytes at
+ * uaddr. ADV_NORMAL, ADV_SEQUENTIAL and ADV_RANDOM are remembered and
+ * decide how much of the file is read ahead when a file-backed page is
+ * loaded, and whether a page is evicted first once the page after it
+ * is loaded. ADV_WILLNEED starts reading the file blocks of
+ * file-backed pages that are not loaded into the buffer cache; swapped
+ * pages are left to be read when touched. ADV_DONTNEED makes loaded
+ * pages the first to be evicted. Returns false, changing nothing, if
+ * some page in the range is not mapped or advice is unknown.
+ */
+bool
+page_advise (const void *uaddr, size_t size, enum advice advice)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *page;
+
+  if (advice > ADV_DONTNEED)
+    return false;
+  for (page = start; page < end; page += PGSIZE)
+    if (page_lookup (page) == NULL)
+      return false;
+
+  for (page = start; page < end; page += PGSIZE)
+  {
+    struct s_page_entry *spe = page_lookup (page);
+    switch (advice)
+    {
+    case ADV_WILLNEED:
+      lock_acquire (&spe->l);
+      if (spe->frame == NULL && spe->type == FILE_BASED)
+        file_advise (spe->info.file.f, spe->info.file.offset,
+                     PGSIZE - spe->info.file.zero_bytes, ADV_WILLNEED);
+      lock_release (&spe->l);
+      break;
+    case ADV_DONTNEED:
+      frame_deprioritize (spe);
+      break;
+    default:
+      spe->advice = advice;
+      break;
+    }
+  }
+  return true;
+}
+
+/**
+ * Unpins the frame of the user page containing uaddr.
+ */
+static void
+page_unpin (const void *uaddr)
+{
+  struct s_page_entry *spe = page_lookup (uaddr);
+  ASSERT (spe != NULL);
+  if (spe->type == SHARED_BASED)
+  {
+    shm_page_unpin (spe);
+    return;
+  }
+  ASSERT (spe->frame != NULL);
+  frame_unpin (spe->frame);
+}
+
+/**
+ * Pins every user page in the size bytes starting at uaddr, loading them
+ * if needed, for the kernel to access them directly. If write is true the
+ * pages must be writable. Returns false, with nothing left pinned, if any
+ * page could not be pinned.
+ */
+bool
+page_pin_range (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *page;
+
+  if (size == 0)
+    return true;
+
+  for (page = start; page < (const uint8_t *) uaddr + size; page += PGSIZE)
+    if (!page_pin (page, write))
+    {
+      while (page > start)
+      {
+        page -= PGSIZE;
+        page_unpin (page);
+      }
+      return false;
+    }
+  return true;
+}
+
+/**
+ * Unpins the user pages pinned by page_pin_range().
+ */
+void
+page_unpin_range (const void *uaddr, size_t size)
+{
+  const uint8_t *page;
+
+  if (size == 0)
+    return;
+
+  for (page = pg_round_down (uaddr); page < (const uint8_t *) uaddr + size;
+       page += PGSIZE)
+    page_unpin (page);
+}
@@ -2,6 +2,7 @@
 #define VM_PAGE_H
 
 #include <hash.h>
+#include <list.h>
 #include <stdbool.h>
 #include "devices/block.h"
 #include "filesys/file.h"
@@ -12,7 +13,8 @@
 enum entry_type
 {
   FILE_BASED,
-  MEMORY_BASED
+  MEMORY_BASED,
+  SHARED_BASED
 };
 
 struct file_based
@@ -30,15 +32,24 @@ struct memory_based
   block_sector_t swap_begin;	/* The starting swap block containing the page*/
 };
 
+struct shared_based
+{
+  struct shm_page *page;	/* Shared memory page mapped here */
+  struct thread *t;		/* Process whose page directory maps it */
+  struct list_elem elem;	/* Entry in the shared page's mappers */
+};
+
 struct s_page_entry 
 {
   enum entry_type type;		/* Type of entry */
   uint8_t *uaddr;		/* User page address (page-aligned) */
   bool writable;		/* Whether page is writable */
+  enum advice advice;		/* ADV_NORMAL, ADV_SEQUENTIAL or ADV_RANDOM */
   union 
   {
     struct file_based file;
     struct memory_based memory;
+    struct shared_based shared;
   } info;				/* Attributes of entry */
   struct frame_entry *frame;	/* Frame entry if frame is allocated */
   struct hash_elem elem;	/* Entry in thread's hash table */
@@ -57,10 +68,15 @@ struct s_page_entry *
 struct s_page_entry *
   vm_add_file_init_page (uint8_t *uaddr, struct file *f, off_t offset,
       size_t zero_bytes);
+bool vm_add_shared_page (uint8_t *uaddr, struct shm_page *page);
 bool vm_free_page (struct s_page_entry *spe);
 
 void page_init_thread (struct thread *t);
 void page_destroy_thread (struct hash_elem *e, void *aux UNUSED);
 bool page_evict (struct thread *t, struct s_page_entry *spe);
 bool page_load (uint8_t *fault_addr);
+bool page_is_valid (const void *uaddr, bool write);
+bool page_advise (const void *uaddr, size_t size, enum advice advice);
+bool page_pin_range (const void *uaddr, size_t size, bool write);
+void page_unpin_range (const void *uaddr, size_t size);
 #endif /* vm/page.h */
@@ -0,0 +1,310 @@
+#include "vm/shm.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Largest segment, in pages */
+#define SHM_MAX_PAGES 1024
+
+/* A named segment of anonymous memory that processes can share */
+struct shm
+{
+  struct list_elem elem;	/* Entry in shm_list */
+  char name[SHM_NAME_MAX + 1];	/* Name given to shm_open() */
+  int ref_cnt;			/* Open fds and mappings of the segment */
+  size_t page_cnt;		/* Number of pages */
+  struct shm_page pages[];	/* The pages themselves */
+};
+
+static struct list shm_list;	/* Segments that are still referenced */
+static struct lock shm_lock;	/* Protects shm_list and every ref_cnt */
+
+/**
+ * Initializes the list of shared memory segments
+ */
+void
+shm_init (void)
+{
+  list_init (&shm_list);
+  lock_init (&shm_lock);
+}
+
+/**
+ * Finds the segment with the given name. The shm_lock must be held.
+ */
+static struct shm *
+shm_lookup (const char *name)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&shm_list); e != list_end (&shm_list);
+       e = list_next (e))
+  {
+    struct shm *shm = list_entry (e, struct shm, elem);
+    if (!strcmp (shm->name, name))
+      return shm;
+  }
+  return NULL;
+}
+
+/**
+ * Returns a reference to the segment with the given name, creating it
+ * with size bytes, rounded up to whole pages of zeros, if there is none.
+ * The size of an existing segment is not changed. Returns NULL if the
+ * name is too long, the segment would be empty or too big, or memory is
+ * exhausted.
+ */
+struct shm *
+shm_open (const char *name, size_t size)
+{
+  if (strlen (name) > SHM_NAME_MAX)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  struct shm *shm = shm_lookup (name);
+  if (shm == NULL)
+  {
+    size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+    if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES
+        || (shm = malloc (sizeof *shm
+                          + page_cnt * sizeof *shm->pages)) == NULL)
+    {
+      lock_release (&shm_lock);
+      return NULL;
+    }
+
+    strlcpy (shm->name, name, sizeof shm->name);
+    shm->ref_cnt = 0;
+    shm->page_cnt = page_cnt;
+
+    /* Pages start out like fresh memory-based pages */
+    size_t i;
+    for (i = 0; i < page_cnt; i++)
+    {
+      struct shm_page *page = &shm->pages[i];
+      lock_init (&page->l);
+      page->frame = NULL;
+      page->memory.used = false;
+      page->memory.swapped = true;
+      list_init (&page->mappers);
+    }
+    list_push_back (&shm_list, &shm->elem);
+  }
+  shm->ref_cnt++;
+  lock_release (&shm_lock);
+
+  return shm;
+}
+
+/**
+ * Takes another reference to a segment
+ */
+void
+shm_dup (struct shm *shm)
+{
+  lock_acquire (&shm_lock);
+  shm->ref_cnt++;
+  lock_release (&shm_lock);
+}
+
+/**
+ * Drops a reference to a segment. Dropping the last one frees the
+ * segment's frames and swap, and frees its name for a new segment.
+ */
+void
+shm_close (struct shm *shm)
+{
+  lock_acquire (&shm_lock);
+  bool destroy = --shm->ref_cnt == 0;
+  if (destroy)
+    list_remove (&shm->elem);
+  lock_release (&shm_lock);
+
+  if (!destroy)
+    return;
+
+  size_t i;
+  for (i = 0; i < shm->page_cnt; i++)
+  {
+    struct shm_page *page = &shm->pages[i];
+
+    /* Nothing maps the page any more, but wait out an eviction that
+       chose its frame */
+    lock_acquire (&page->l);
+    ASSERT (list_empty (&page->mappers));
+    if (page->frame != NULL)
+      frame_free (page->frame);
+    else if (page->memory.used)
+      swap_free (page->memory.swap_begin);
+    lock_release (&page->l);
+  }
+  free (shm);
+}
+
+/**
+ * Returns the number of pages in a segment
+ */
+size_t
+shm_page_cnt (const struct shm *shm)
+{
+  return shm->page_cnt;
+}
+
+/**
+ * Returns page idx of a segment
+ */
+struct shm_page *
+shm_get_page (struct shm *shm, size_t idx)
+{
+  ASSERT (idx < shm->page_cnt);
+  return &shm->pages[idx];
+}
+
+/**
+ * Records that a new shared supplemental page entry maps its page, so
+ * that eviction will unmap it.
+ */
+void
+shm_page_attach (struct s_page_entry *spe)
+{
+  struct shm_page *page = spe->info.shared.page;
+
+  lock_acquire (&page->l);
+  list_push_back (&page->mappers, &spe->info.shared.elem);
+  lock_release (&page->l);
+}
+
+/**
+ * Unmaps a shared supplemental page entry from its process and forgets
+ * it. The frame stays for the page's other mappers.
+ */
+void
+shm_page_detach (struct s_page_entry *spe)
+{
+  struct shm_page *page = spe->info.shared.page;
+
+  lock_acquire (&page->l);
+  pagedir_clear_page (spe->info.shared.t->pagedir, spe->uaddr);
+  list_remove (&spe->info.shared.elem);
+  lock_release (&page->l);
+}
+
+/**
+ * Maps the shared page of spe into the current process, first reading
+ * it into a frame if no other process has it loaded. If pin is true the
+ * frame is left pinned, as by frame_pin().
+ */
+bool
+shm_page_load (struct s_page_entry *spe, bool pin)
+{
+  struct shm_page *page = spe->info.shared.page;
+  struct thread *t = thread_current ();
+  bool success = true;
+
+  lock_acquire (&page->l);
+  if (page->frame == NULL)
+  {
+    struct frame_entry *frame = frame_get (NULL, page->memory.used
+                                                 ? 0 : VM_ZERO);
+    if (frame == NULL)
+    {
+      lock_release (&page->l);
+      return false;
+    }
+    if (page->memory.used)
+      swap_load (frame->kaddr, page->memory.swap_begin);
+    page->memory.used = true;
+    page->memory.swapped = false;
+
+    /* While the page's lock is held, the clock cannot choose the
+       frame, so it may be unpinned right away */
+    frame->shared = page;
+    page->frame = frame;
+    frame_unpin (frame);
+  }
+
+  if (pagedir_get_page (t->pagedir, spe->uaddr) == NULL)
+    success = pagedir_set_page (t->pagedir, spe->uaddr, page->frame->kaddr,
+                                spe->writable);
+
+  /* Frames are pinned without a nested pin only while loading or
+     evicting, which both hold the page's lock */
+  if (success && pin && !frame_pin (page->frame))
+    PANIC ("Shared frame pinned behind its page's lock");
+  lock_release (&page->l);
+
+  return success;
+}
+
+/**
+ * Unpins the frame that shm_page_load() pinned for spe.
+ */
+void
+shm_page_unpin (struct s_page_entry *spe)
+{
+  struct shm_page *page = spe->info.shared.page;
+
+  /* A pinned frame is not evicted, so page->frame is stable */
+  ASSERT (page->frame != NULL);
+  frame_unpin (page->frame);
+}
+
+/**
+ * Returns whether any process mapping page has accessed it since the
+ * last call, clearing their accessed bits. The page's lock must be held.
+ */
+bool
+shm_page_accessed (struct shm_page *page)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&page->l));
+  for (e = list_begin (&page->mappers); e != list_end (&page->mappers);
+       e = list_next (e))
+  {
+    struct s_page_entry *spe = list_entry (e, struct s_page_entry,
+                                           info.shared.elem);
+    uint32_t *pd = spe->info.shared.t->pagedir;
+    if (pagedir_is_accessed (pd, spe->uaddr))
+    {
+      accessed = true;
+      pagedir_set_accessed (pd, spe->uaddr, false);
+    }
+  }
+  return accessed;
+}
+
+/**
+ * Evicts a shared page from its pinned frame: unmaps it from every
+ * process that maps it and writes it to swap. Does not free the frame.
+ * The page's lock must be held.
+ */
+void
+shm_page_evict (struct shm_page *page)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&page->l));
+  ASSERT (page->frame != NULL && page->frame->pinned);
+
+  for (e = list_begin (&page->mappers); e != list_end (&page->mappers);
+       e = list_next (e))
+  {
+    struct s_page_entry *spe = list_entry (e, struct s_page_entry,
+                                           info.shared.elem);
+    pagedir_clear_page (spe->info.shared.t->pagedir, spe->uaddr);
+  }
+
+  /* Loading from swap frees the swap slot, so a loaded page is always
+     written back, as page_swap() does for memory-based pages */
+  swap_write (page->frame->kaddr, &page->memory.swap_begin);
+  page->memory.swapped = true;
+  page->frame = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
+#include "vm/page.h"
+
+/* Longest name of a shared memory segment */
+#define SHM_NAME_MAX 14
+
+/* One page of a shared memory segment.  A single frame holds it for
+   every process that maps it. */
+struct shm_page
+{
+  struct lock l;		/* Protects the fields below */
+  struct frame_entry *frame;	/* Frame holding the page, or NULL */
+  struct memory_based memory;	/* Swap state while frame is NULL */
+  struct list mappers;		/* s_page_entrys that map the page */
+};
+
+struct shm;
+
+void shm_init (void);
+struct shm *shm_open (const char *name, size_t size);
+void shm_dup (struct shm *shm);
+void shm_close (struct shm *shm);
+size_t shm_page_cnt (const struct shm *shm);
+struct shm_page *shm_get_page (struct shm *shm, size_t idx);
+
+void shm_page_attach (struct s_page_entry *spe);
+void shm_page_detach (struct s_page_entry *spe);
+bool shm_page_load (struct s_page_entry *spe, bool pin);
+void shm_page_unpin (struct s_page_entry *spe);
+bool shm_page_accessed (struct shm_page *page);
+void shm_page_evict (struct shm_page *page);
+
+#endif /* vm/shm.h */